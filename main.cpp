@@ -1,15 +1,56 @@
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <fstream>
 #include <map>
+#include <memory_resource>
+#include <unordered_map>
 #include <stdexcept>
 #include <sstream>
 #include <algorithm>
-#include <variant>
+#include <functional>
 #include <limits>
 #include <cmath> // Добавлен для математических функций
 #include <corecrt_math_defines.h>
+#include <cstdlib>
+#include <cstdio>
+#include <new>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <charconv>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#endif
+#if defined(__x86_64__) || defined(_M_X64)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+// Счётчик выделений памяти в куче (для проверки горячего пути интерпретатора, см. --count-allocs)
+static unsigned long long g_heapAllocations = 0;
+
+void *operator new(std::size_t size)
+{
+    ++g_heapAllocations;
+    if (void *ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
 
 // Token Codes
 enum TokenCode
@@ -62,14 +103,117 @@ enum TokenCode
     NEWLINE_TOK // Обычно пропускается или влияет на номер строки
 };
 
+// Арена фронтенда: всё, что нужно только до конца компиляции одной программы (тексты лексем,
+// индекс интернера, служебные таблицы парсера), выделяется подряд из крупных блоков и
+// освобождается одной операцией - в деструкторе. Результат компиляции (ОПЗ и таблица символов)
+// в арене не хранится и переживает её.
+class FrontEndArena
+{
+public:
+    explicit FrontEndArena(size_t first_block_size = 64 * 1024) : m_resource(first_block_size) {}
+
+    FrontEndArena(const FrontEndArena &) = delete;
+    FrontEndArena &operator=(const FrontEndArena &) = delete;
+
+    std::pmr::memory_resource *resource() { return &m_resource; }
+
+    std::string_view store(std::string_view text)
+    {
+        char *copy = static_cast<char *>(m_resource.allocate(text.size() ? text.size() : 1, 1));
+        std::memcpy(copy, text.data(), text.size());
+        return std::string_view(copy, text.size());
+    }
+
+private:
+    std::pmr::monotonic_buffer_resource m_resource;
+};
+
+// Пул интернированных строк, общий для лексера, парсера и таблицы символов: одинаковые лексемы
+// получают один и тот же id, а токены хранят только этот id
+class StringInterner
+{
+public:
+    explicit StringInterner(FrontEndArena &arena)
+        : m_arena(&arena), m_strings(arena.resource()), m_index(arena.resource()) {}
+
+    int intern(std::string_view text)
+    {
+        auto it = m_index.find(text);
+        if (it != m_index.end())
+            return it->second;
+        int id = static_cast<int>(m_strings.size());
+        m_strings.push_back(m_arena->store(text)); // The arena never moves stored text, so the key stays valid
+        m_index.emplace(m_strings.back(), id);
+        return id;
+    }
+
+    std::string_view view(int id) const { return m_strings[static_cast<size_t>(id)]; }
+    size_t size() const { return m_strings.size(); }
+    FrontEndArena &arena() const { return *m_arena; }
+
+private:
+    FrontEndArena *m_arena;
+    std::pmr::vector<std::string_view> m_strings;
+    std::pmr::unordered_map<std::string_view, int> m_index;
+};
+
 //  Token Structure
 struct Token
 {
+    static const int kNoLexeme = -1;
+
     TokenCode code;
-    std::string lexeme;
+    int lexeme_id; // Interned text of identifiers, keywords and numbers; kNoLexeme for punctuation and EOF
     int line;
 
-    Token(TokenCode c = NONE_TOK, std::string l = "", int ln = 0) : code(c), lexeme(std::move(l)), line(ln) {}
+    Token(TokenCode c = NONE_TOK, int id = kNoLexeme, int ln = 0) : code(c), lexeme_id(id), line(ln) {}
+
+    std::string_view lexeme(const StringInterner &pool) const
+    {
+        return lexeme_id == kNoLexeme ? spelling(code) : pool.view(lexeme_id);
+    }
+
+    // Fixed text of tokens that are not interned
+    static std::string_view spelling(TokenCode code)
+    {
+        switch (code)
+        {
+        case PLUS_TOK:
+            return "+";
+        case MINUS_TOK:
+            return "-";
+        case STAR_TOK:
+            return "*";
+        case SLASH_TOK:
+            return "/";
+        case EQ_TOK:
+            return "=";
+        case EQ_COMPARE_TOK:
+            return "~";
+        case GT_TOK:
+            return ">";
+        case LT_TOK:
+            return "<";
+        case NOT_TOK:
+            return "!";
+        case LPAREN_TOK:
+            return "(";
+        case RPAREN_TOK:
+            return ")";
+        case LBRACKET_TOK:
+            return "[";
+        case RBRACKET_TOK:
+            return "]";
+        case SEMICOLON_TOK:
+            return ";";
+        case DOLLAR_TOK:
+            return "$";
+        case EOF_TOK:
+            return "EOF";
+        default:
+            return "";
+        }
+    }
 
     std::string codeToString() const
     {
@@ -183,13 +327,18 @@ const int CAT_TILDE = 18; // ~ (для сравнения на равенств
 const int CAT_OTHER = 19;
 const int NUM_CHAR_CATEGORIES = 20;
 
-int lexTable[3][NUM_CHAR_CATEGORIES];
-int AsciiTable[128];
-std::map<std::string, TokenCode> keywords;
+// Таблицы лексера строятся при компиляции: нет инициализации при запуске и общего изменяемого состояния
+struct LexerTables
+{
+    int ascii[128];                      // Character -> category
+    int actions[3][NUM_CHAR_CATEGORIES]; // State x category -> semantic program
+};
 
-// Initialize AsciiTable
-void initialize_lexer_tables()
+constexpr LexerTables make_lexer_tables()
 {
+    LexerTables tables{};
+    auto &AsciiTable = tables.ascii;
+    auto &lexTable = tables.actions;
 
     for (int i = 0; i < 128; ++i)
     {
@@ -242,7 +391,7 @@ void initialize_lexer_tables()
     // 19: Ошибка в S_STATE
     // 20: '$'
     // 21: Продолжить идентификатор/ключ.слово
-    // 22: Завершить идентификатор/ключ.слово (посмотреть в keywords)
+    // 22: Завершить идентификатор/ключ.слово (см. keyword_code)
     // 24: Ошибка в A_STATE или B_STATE (недопустимый символ после начала)
     // 27: Продолжить число
     // 28: Завершить число
@@ -285,238 +434,433 @@ void initialize_lexer_tables()
     lexTable[B_STATE][CAT_OTHER] = 24;  // Ошибка, если другой символ (кроме тех, что завершают)
     lexTable[B_STATE][CAT_LETTER] = 24; // Буква после числа - ошибка
 
-    // Initialize keywords
-    keywords["if"] = IF_TOK;
-    keywords["else"] = ELSE_TOK;
-    keywords["while"] = WHILE_TOK;
-    keywords["input"] = INPUT_TOK;   // грамматика использует 'cin'
-    keywords["output"] = OUTPUT_TOK; // грамматика использует 'cout'
-    keywords["int"] = INT_TOK;
-    keywords["arr"] = IMAS_TOK; // 'arr' для объявления массива, соответствует IMAS_TOK
-    keywords["begin"] = BEG_TOK;
-    keywords["end"] = END_TOK;
-    // Специально для грамматики:
-    keywords["cin"] = INPUT_TOK;
-    keywords["cout"] = OUTPUT_TOK;
-    // Тригонометрические функции:
-    keywords["sin"] = SIN_TOK;
-    keywords["cos"] = COS_TOK;
-    keywords["tg"] = TG_TOK;
-    keywords["ctg"] = CTG_TOK;
+    return tables;
 }
 
-// Lexer Class
-class Lexer
+constexpr LexerTables kLexerTables = make_lexer_tables();
+
+// Ключевые слова: выбор по длине, затем по первой букве, затем одно сравнение.
+// Всё вычисляется при компиляции, если аргумент известен (см. static_assert ниже)
+constexpr TokenCode keyword_code(std::string_view word)
+{
+    switch (word.size())
+    {
+    case 2:
+        if (word[0] == 'i')
+            return word == "if" ? IF_TOK : ID_TOK;
+        if (word[0] == 't')
+            return word == "tg" ? TG_TOK : ID_TOK;
+        break;
+    case 3:
+        switch (word[0])
+        {
+        case 'i':
+            return word == "int" ? INT_TOK : ID_TOK;
+        case 'a':
+            return word == "arr" ? IMAS_TOK : ID_TOK; // 'arr' для объявления массива, соответствует IMAS_TOK
+        case 'e':
+            return word == "end" ? END_TOK : ID_TOK;
+        case 's':
+            return word == "sin" ? SIN_TOK : ID_TOK;
+        case 'c':
+            if (word == "cin") // Специально для грамматики: синоним 'input'
+                return INPUT_TOK;
+            if (word == "cos")
+                return COS_TOK;
+            return word == "ctg" ? CTG_TOK : ID_TOK;
+        }
+        break;
+    case 4:
+        if (word[0] == 'e')
+            return word == "else" ? ELSE_TOK : ID_TOK;
+        if (word[0] == 'c')
+            return word == "cout" ? OUTPUT_TOK : ID_TOK; // Синоним 'output'
+        break;
+    case 5:
+        if (word[0] == 'w')
+            return word == "while" ? WHILE_TOK : ID_TOK;
+        if (word[0] == 'i')
+            return word == "input" ? INPUT_TOK : ID_TOK;
+        if (word[0] == 'b')
+            return word == "begin" ? BEG_TOK : ID_TOK;
+        break;
+    case 6:
+        return word == "output" ? OUTPUT_TOK : ID_TOK;
+    }
+    return ID_TOK;
+}
+
+static_assert(keyword_code("while") == WHILE_TOK && keyword_code("cin") == INPUT_TOK && keyword_code("ctg") == CTG_TOK &&
+                  keyword_code("cos") == COS_TOK && keyword_code("co") == ID_TOK && keyword_code("outputs") == ID_TOK,
+              "keyword_code() is out of sync with the keyword list");
+static_assert(kLexerTables.ascii['~'] == CAT_TILDE && kLexerTables.actions[B_STATE][CAT_LETTER] == 24,
+              "lexer tables must be built at compile time");
+
+// Весь исходный текст одним буфером: файл отображается в память (mmap / MapViewOfFile),
+// ручной ввод хранится в строке. Лексемы токенов — string_view внутрь этого буфера,
+// поэтому SourceBuffer должен жить дольше токенов.
+class SourceBuffer
 {
 public:
-    Lexer(std::istream &in_stream) : input_stream(in_stream), current_line(1), char_buffer_valid(false)
+    SourceBuffer() = default;
+    ~SourceBuffer() { unmap(); }
+
+    SourceBuffer(const SourceBuffer &) = delete;
+    SourceBuffer &operator=(const SourceBuffer &) = delete;
+
+    // Returns false if the file cannot be opened
+    bool mapFile(const std::string &path)
     {
-        static bool tables_initialized = false;
-        if (!tables_initialized)
+        unmap();
+#ifdef _WIN32
+        m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size;
+        if (GetFileSizeEx(m_file, &size) && size.QuadPart > 0)
+        {
+            m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (m_mapping)
+            {
+                m_mapped = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+                if (m_mapped)
+                {
+                    m_text = std::string_view(static_cast<const char *>(m_mapped), static_cast<size_t>(size.QuadPart));
+                    return true;
+                }
+            }
+        }
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
         {
-            initialize_lexer_tables();
-            tables_initialized = true;
+            void *mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED)
+            {
+                madvise(mapped, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL); // Read once, front to back
+                close(fd);
+                m_mapped = mapped;
+                m_mappedSize = static_cast<size_t>(st.st_size);
+                m_text = std::string_view(static_cast<const char *>(mapped), m_mappedSize);
+                return true;
+            }
         }
+        close(fd);
+#endif
+        // Empty files, pipes and mapping failures: read the whole file instead
+        unmap();
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open())
+            return false;
+        std::ostringstream contents;
+        contents << in.rdbuf();
+        assign(contents.str());
+        return true;
+    }
+
+    void assign(std::string text)
+    {
+        unmap();
+        m_owned = std::move(text);
+        m_text = m_owned;
+    }
+
+    std::string_view text() const { return m_text; }
+
+private:
+    std::string_view m_text;
+    std::string m_owned;
+    void *m_mapped = nullptr;
+#ifdef _WIN32
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+#else
+    size_t m_mappedSize = 0;
+#endif
+
+    void unmap()
+    {
+#ifdef _WIN32
+        if (m_mapped)
+            UnmapViewOfFile(m_mapped);
+        if (m_mapping)
+            CloseHandle(m_mapping);
+        if (m_file != INVALID_HANDLE_VALUE)
+            CloseHandle(m_file);
+        m_mapping = nullptr;
+        m_file = INVALID_HANDLE_VALUE;
+#else
+        if (m_mapped)
+            munmap(m_mapped, m_mappedSize);
+        m_mappedSize = 0;
+#endif
+        m_mapped = nullptr;
+        m_text = std::string_view();
     }
+};
+
+// Lexer Class
+class Lexer
+{
+public:
+    Lexer(std::string_view source, StringInterner &pool)
+        : m_pos(source.data()), m_end(source.data() + source.size()), m_pool(pool), current_line(1) {}
 
     Token getNextToken()
     {
-        std::string current_lexeme = "";
+        // The current lexeme is always the contiguous span [lexeme_start, lexeme_start + lexeme_length)
+        const char *lexeme_start = m_pos;
+        size_t lexeme_length = 0;
         int currentState = S_STATE;
         int token_start_line = current_line;
 
         while (true)
         {
-            int ch_int = get_char();
-            char c = static_cast<char>(ch_int);
-
-            if (ch_int == EOF)
+            if (m_pos == m_end)
             {
-                if (!current_lexeme.empty())
+                if (lexeme_length != 0)
                 {
                     if (currentState == A_STATE)
-                        return finalize_identifier(current_lexeme, token_start_line);
+                        return finalize_identifier(std::string_view(lexeme_start, lexeme_length), token_start_line);
                     if (currentState == B_STATE)
-                        return finalize_number(current_lexeme, token_start_line);
+                        return finalize_number(std::string_view(lexeme_start, lexeme_length), token_start_line);
                 }
-                return Token(EOF_TOK, "EOF", current_line);
+                return Token(EOF_TOK, Token::kNoLexeme, current_line);
             }
 
-            int char_category = (ch_int < 0 || ch_int > 127) ? CAT_OTHER : AsciiTable[ch_int];
-            int semantic_action = lexTable[currentState][char_category];
+            const char *char_pos = m_pos++;
+            char c = *char_pos;
+            unsigned char uc = static_cast<unsigned char>(c);
+            std::string_view single(char_pos, 1);
+
+            int char_category = uc > 127 ? CAT_OTHER : kLexerTables.ascii[uc];
+            int semantic_action = kLexerTables.actions[currentState][char_category];
 
             switch (semantic_action)
             {
             case 1:
-                current_lexeme += c;
+                lexeme_start = char_pos;
+                lexeme_length = 1;
                 currentState = A_STATE;
                 token_start_line = current_line;
                 break;
             case 2:
-                current_lexeme += c;
+                lexeme_start = char_pos;
+                lexeme_length = 1;
                 currentState = B_STATE;
                 token_start_line = current_line;
                 break;
             case 3:
-                return Token(PLUS_TOK, std::string(1, c), current_line);
+                return Token(PLUS_TOK, Token::kNoLexeme, current_line);
             case 4:
-                return Token(MINUS_TOK, std::string(1, c), current_line);
+                return Token(MINUS_TOK, Token::kNoLexeme, current_line);
             case 5:
-                return Token(EQ_TOK, std::string(1, c), current_line);
+                return Token(EQ_TOK, Token::kNoLexeme, current_line);
             case 6:
-                return Token(STAR_TOK, std::string(1, c), current_line);
+                return Token(STAR_TOK, Token::kNoLexeme, current_line);
             case 7:
-                return Token(SLASH_TOK, std::string(1, c), current_line);
+                return Token(SLASH_TOK, Token::kNoLexeme, current_line);
             case 8:
                 currentState = S_STATE;
-                current_lexeme = "";
+                lexeme_length = 0;
                 break; // Пробел
             case 9:
-                return Token(LPAREN_TOK, std::string(1, c), current_line);
+                return Token(LPAREN_TOK, Token::kNoLexeme, current_line);
             case 10:
-                return Token(RPAREN_TOK, std::string(1, c), current_line);
+                return Token(RPAREN_TOK, Token::kNoLexeme, current_line);
             case 11:
-                return Token(LBRACKET_TOK, std::string(1, c), current_line);
+                return Token(LBRACKET_TOK, Token::kNoLexeme, current_line);
             case 12:
-                return Token(RBRACKET_TOK, std::string(1, c), current_line);
+                return Token(RBRACKET_TOK, Token::kNoLexeme, current_line);
             case 13:
-                return Token(GT_TOK, std::string(1, c), current_line);
+                return Token(GT_TOK, Token::kNoLexeme, current_line);
             case 14:
-                return Token(LT_TOK, std::string(1, c), current_line);
+                return Token(LT_TOK, Token::kNoLexeme, current_line);
             case 15:
-                return Token(NOT_TOK, std::string(1, c), current_line); // !
+                return Token(NOT_TOK, Token::kNoLexeme, current_line); // !
             case 16:
-                return Token(SEMICOLON_TOK, std::string(1, c), current_line);
+                return Token(SEMICOLON_TOK, Token::kNoLexeme, current_line);
             case 18:
                 current_line++;
                 currentState = S_STATE;
-                current_lexeme = "";
+                lexeme_length = 0;
                 break; // \n
             case 19:   // Ошибка в S_STATE
                 std::cerr << "Lexical Error (Line " << current_line << "): Invalid character '" << c << "' in initial state." << std::endl;
-                current_lexeme = "";
+                lexeme_length = 0;
                 currentState = S_STATE; // Пропустить символ и сбросить
                 break;
             case 20:
-                return Token(DOLLAR_TOK, std::string(1, c), current_line);
+                return Token(DOLLAR_TOK, Token::kNoLexeme, current_line);
             case 21: // Продолжить идентификатор/ключ.слово
-                if (current_lexeme.length() < LEXER_BUFFER_SIZE - 1)
+                if (lexeme_length < LEXER_BUFFER_SIZE - 1)
                 {
-                    current_lexeme += c;
+                    ++lexeme_length;
                 }
                 else
                 {
-                    std::cerr << "Lexical Error (Line " << token_start_line << "): Identifier too long: " << current_lexeme << "..." << std::endl;
-                    unget_char(c);
-                    return finalize_identifier(current_lexeme, token_start_line);
+                    std::cerr << "Lexical Error (Line " << token_start_line << "): Identifier too long: " << std::string_view(lexeme_start, lexeme_length) << "..." << std::endl;
+                    --m_pos;
+                    return finalize_identifier(std::string_view(lexeme_start, lexeme_length), token_start_line);
                 }
                 break;
             case 22: // Завершить идентификатор/ключ.слово
-                unget_char(c);
-                return finalize_identifier(current_lexeme, token_start_line);
+                --m_pos;
+                return finalize_identifier(std::string_view(lexeme_start, lexeme_length), token_start_line);
             case 24: // Ошибка в A_STATE или B_STATE
-                unget_char(c);
-                std::cerr << "Lexical Error (Line " << token_start_line << "): Invalid character '" << c << "' after '" << current_lexeme << "'" << std::endl;
-                if (!current_lexeme.empty())
+                --m_pos;
+                std::cerr << "Lexical Error (Line " << token_start_line << "): Invalid character '" << c << "' after '" << std::string_view(lexeme_start, lexeme_length) << "'" << std::endl;
+                if (lexeme_length != 0)
                 {
                     if (currentState == A_STATE)
                     {
-                        return finalize_identifier(current_lexeme, token_start_line);
+                        return finalize_identifier(std::string_view(lexeme_start, lexeme_length), token_start_line);
                     }
                     else if (currentState == B_STATE)
                     {
-                        return finalize_number(current_lexeme, token_start_line);
+                        return finalize_number(std::string_view(lexeme_start, lexeme_length), token_start_line);
                     }
                 }
-                return Token(ERROR_TOK, current_lexeme + c, token_start_line);
+                return Token(ERROR_TOK, m_pool.intern(single), token_start_line);
             case 27: // Продолжить число
-                if (current_lexeme.length() < LEXER_BUFFER_SIZE - 1)
+                if (lexeme_length < LEXER_BUFFER_SIZE - 1)
                 {
-                    current_lexeme += c;
+                    ++lexeme_length;
                 }
                 else
                 {
-                    std::cerr << "Lexical Error (Line " << token_start_line << "): Number too long: " << current_lexeme << "..." << std::endl;
-                    unget_char(c);
-                    return finalize_number(current_lexeme, token_start_line);
+                    std::cerr << "Lexical Error (Line " << token_start_line << "): Number too long: " << std::string_view(lexeme_start, lexeme_length) << "..." << std::endl;
+                    --m_pos;
+                    return finalize_number(std::string_view(lexeme_start, lexeme_length), token_start_line);
                 }
                 break;
             case 28: // Завершить число
-                unget_char(c);
-                return finalize_number(current_lexeme, token_start_line);
+                --m_pos;
+                return finalize_number(std::string_view(lexeme_start, lexeme_length), token_start_line);
             case 30:
-                return Token(EQ_COMPARE_TOK, std::string(1, c), current_line); // Сравнение ~
+                return Token(EQ_COMPARE_TOK, Token::kNoLexeme, current_line); // Сравнение ~
 
             default:
                 std::cerr << "Lexical Error (Line " << current_line << "): Unknown semantic action " << semantic_action
                           << " for char '" << c << "' (cat " << char_category << ") in state " << currentState << std::endl;
-                return Token(ERROR_TOK, std::string(1, c), current_line);
+                return Token(ERROR_TOK, m_pool.intern(single), current_line);
             }
         }
     }
 
 private:
-    std::istream &input_stream;
+    const char *m_pos; // Next character to read; "unget" is --m_pos
+    const char *m_end;
+    StringInterner &m_pool;
     int current_line;
-    char char_buffer;
-    bool char_buffer_valid;
-
-    int get_char()
-    {
-        if (char_buffer_valid)
-        {
-            char_buffer_valid = false;
-            return char_buffer;
-        }
-        return input_stream.get();
-    }
-
-    void unget_char(char c)
-    {
-        char_buffer = c;
-        char_buffer_valid = true;
-    }
 
-    Token finalize_identifier(const std::string &lexeme, int line_num)
+    Token finalize_identifier(std::string_view lexeme, int line_num)
     {
-        auto it = keywords.find(lexeme);
-        if (it != keywords.end())
-        {
-            return Token(it->second, lexeme, line_num);
-        }
-        return Token(ID_TOK, lexeme, line_num);
+        return Token(keyword_code(lexeme), m_pool.intern(lexeme), line_num);
     }
 
-    Token finalize_number(const std::string &lexeme, int line_num)
+    Token finalize_number(std::string_view lexeme, int line_num)
     {
-        return Token(NUM_TOK, lexeme, line_num);
+        return Token(NUM_TOK, m_pool.intern(lexeme), line_num);
     }
 };
 
 // RPN (OPS) Generator Structures
 enum class RPNItemType
 {
-    VAR,
+    VAR,     // Загрузка значения переменной (rvalue)
+    VAR_REF, // Ссылка на переменную для '=' и cin (lvalue)
     ARRAY_BASE,
     CONST,
     OPERATION,
-    LABEL_DEF,
-    JUMP,
-    JUMP_FALSE,
+    JUMP,       // Безусловный переход, operand = индекс целевой записи ОПЗ
+    JUMP_FALSE, // Переход по лжи, operand = индекс целевой записи ОПЗ
     ARRAY_ACCESS,
     ARRAY_ASSIGN,
     INPUT,
     OUTPUT,
-    TRIG_FUNCTION // Новый тип для тригонометрических функций
+    TRIG_FUNCTION, // Новый тип для тригонометрических функций
+    SUPERINSTRUCTION // Несколько записей, слитых fuse_superinstructions()
 };
 
+// Операция ОПЗ, декодированная генератором один раз; интерпретатор выбирает её одним switch
+enum class RPNOpcode : unsigned char
+{
+    LOAD_VAR,     // VAR
+    PUSH_VAR_REF, // VAR_REF
+    PUSH_ARRAY,   // ARRAY_BASE
+    PUSH_CONST,   // CONST
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    CMP_EQ, // ~
+    CMP_GT, // >
+    CMP_LT, // <
+    CMP_NE, // !
+    NEG,    // unary-
+    ASSIGN,       // =
+    ARRAY_ASSIGN, // []=
+    ARRAY_LOAD,   // []
+    JUMP,
+    JUMP_FALSE,
+    INPUT,       // IN
+    INPUT_ARRAY, // IN[]
+    OUTPUT,
+    SIN,
+    COS,
+    TG,
+    CTG,
+    // Суперинструкции (см. fuse_superinstructions)
+    LOAD_ADD_CONST, // VAR x, CONST k, +/-  ->  push x + k (operand = slot, operand2 = k)
+    LOAD_ARRAY_VAR, // ARRAY_BASE a, VAR i, []  ->  push a[i] (operand = array slot, operand2 = index variable slot)
+    JUMP_FALSE_EQ,  // ~ followed by JUMP_FALSE (operand = target)
+    JUMP_FALSE_GT,  // > followed by JUMP_FALSE
+    JUMP_FALSE_LT,  // < followed by JUMP_FALSE
+    JUMP_FALSE_NE,  // ! followed by JUMP_FALSE
+    // Доступ к массиву без проверки границ: индекс доказан eliminate_bounds_checks()
+    ARRAY_ASSIGN_UNCHECKED,
+    ARRAY_LOAD_UNCHECKED,
+    LOAD_ARRAY_VAR_UNCHECKED
+};
+constexpr int kRPNOpcodeCount = static_cast<int>(RPNOpcode::LOAD_ARRAY_VAR_UNCHECKED) + 1; // Keep in sync with the last opcode
+
 struct RPNEntry
 {
     RPNItemType type;
-    std::string value;
-    int line_num; // Line number from source for error reporting
+    RPNOpcode opcode;
+    std::string value; // Source text (identifier, number, operator), used for listings and error messages
+    int line_num;      // Line number from source for error reporting
+    int operand;       // Slot index for VAR/VAR_REF/ARRAY_BASE, value for CONST, target RPN index for jumps, -1 otherwise
+    int operand2;      // Second operand of superinstructions
 
-    RPNEntry(RPNItemType t, std::string val, int line) : type(t), value(std::move(val)), line_num(line) {}
+    RPNEntry(RPNItemType t, RPNOpcode op, std::string val, int line, int arg = -1, int arg2 = 0)
+        : type(t), opcode(op), value(std::move(val)), line_num(line), operand(arg), operand2(arg2) {}
+
+    // Текст для листинга ОПЗ: у переходов показывается индекс цели
+    std::string displayValue() const
+    {
+        switch (opcode)
+        {
+        case RPNOpcode::JUMP:
+        case RPNOpcode::JUMP_FALSE:
+            return std::to_string(operand);
+        case RPNOpcode::JUMP_FALSE_EQ:
+        case RPNOpcode::JUMP_FALSE_GT:
+        case RPNOpcode::JUMP_FALSE_LT:
+        case RPNOpcode::JUMP_FALSE_NE:
+            return value + " " + std::to_string(operand);
+        case RPNOpcode::ARRAY_ASSIGN_UNCHECKED:
+        case RPNOpcode::ARRAY_LOAD_UNCHECKED:
+        case RPNOpcode::LOAD_ARRAY_VAR_UNCHECKED:
+            return value + " (unchecked)";
+        default:
+            return value;
+        }
+    }
 
     std::string typeToString() const
     {
@@ -524,14 +868,14 @@ struct RPNEntry
         {
         case RPNItemType::VAR:
             return "VAR";
+        case RPNItemType::VAR_REF:
+            return "VAR_REF";
         case RPNItemType::ARRAY_BASE:
             return "ARRAY_BASE";
         case RPNItemType::CONST:
             return "CONST";
         case RPNItemType::OPERATION:
             return "OPERATION";
-        case RPNItemType::LABEL_DEF:
-            return "LABEL_DEF";
         case RPNItemType::JUMP:
             return "JUMP";
         case RPNItemType::JUMP_FALSE:
@@ -546,12 +890,195 @@ struct RPNEntry
             return "OUTPUT_OP";
         case RPNItemType::TRIG_FUNCTION:
             return "TRIG_FUNCTION";
+        case RPNItemType::SUPERINSTRUCTION:
+            return "SUPERINSTRUCTION";
         default:
             return "UNKNOWN_RPN_TYPE";
         }
     }
 };
 
+// Stack effect of one RPN operation: how many values/references it pops and pushes
+struct RPNStackEffect
+{
+    int pop_values;
+    int push_values;
+    int pop_refs;
+    int push_refs;
+};
+
+RPNStackEffect rpn_stack_effect(RPNOpcode op)
+{
+    switch (op)
+    {
+    case RPNOpcode::LOAD_VAR:
+    case RPNOpcode::PUSH_CONST:
+        return {0, 1, 0, 0};
+    case RPNOpcode::PUSH_VAR_REF:
+    case RPNOpcode::PUSH_ARRAY:
+        return {0, 0, 0, 1};
+    case RPNOpcode::ADD:
+    case RPNOpcode::SUB:
+    case RPNOpcode::MUL:
+    case RPNOpcode::DIV:
+    case RPNOpcode::CMP_EQ:
+    case RPNOpcode::CMP_GT:
+    case RPNOpcode::CMP_LT:
+    case RPNOpcode::CMP_NE:
+        return {2, 1, 0, 0};
+    case RPNOpcode::NEG:
+    case RPNOpcode::SIN:
+    case RPNOpcode::COS:
+    case RPNOpcode::TG:
+    case RPNOpcode::CTG:
+        return {1, 1, 0, 0};
+    case RPNOpcode::ASSIGN:
+        return {1, 0, 1, 0};
+    case RPNOpcode::ARRAY_ASSIGN:
+    case RPNOpcode::ARRAY_ASSIGN_UNCHECKED:
+        return {2, 0, 1, 0};
+    case RPNOpcode::ARRAY_LOAD:
+    case RPNOpcode::ARRAY_LOAD_UNCHECKED:
+        return {1, 1, 1, 0};
+    case RPNOpcode::JUMP:
+        return {0, 0, 0, 0};
+    case RPNOpcode::JUMP_FALSE:
+    case RPNOpcode::OUTPUT:
+        return {1, 0, 0, 0};
+    case RPNOpcode::INPUT:
+        return {0, 0, 1, 0};
+    case RPNOpcode::INPUT_ARRAY:
+        return {1, 0, 1, 0};
+    case RPNOpcode::LOAD_ADD_CONST:
+    case RPNOpcode::LOAD_ARRAY_VAR:
+    case RPNOpcode::LOAD_ARRAY_VAR_UNCHECKED:
+        return {0, 1, 0, 0};
+    case RPNOpcode::JUMP_FALSE_EQ:
+    case RPNOpcode::JUMP_FALSE_GT:
+    case RPNOpcode::JUMP_FALSE_LT:
+    case RPNOpcode::JUMP_FALSE_NE:
+        return {2, 0, 0, 0};
+    }
+    throw std::runtime_error("Unknown RPN opcode " + std::to_string(static_cast<int>(op)) + ".");
+}
+
+const char *rpn_opcode_name(RPNOpcode op)
+{
+    switch (op)
+    {
+    case RPNOpcode::LOAD_VAR: return "LOAD_VAR";
+    case RPNOpcode::PUSH_VAR_REF: return "PUSH_VAR_REF";
+    case RPNOpcode::PUSH_ARRAY: return "PUSH_ARRAY";
+    case RPNOpcode::PUSH_CONST: return "PUSH_CONST";
+    case RPNOpcode::ADD: return "ADD";
+    case RPNOpcode::SUB: return "SUB";
+    case RPNOpcode::MUL: return "MUL";
+    case RPNOpcode::DIV: return "DIV";
+    case RPNOpcode::CMP_EQ: return "CMP_EQ";
+    case RPNOpcode::CMP_GT: return "CMP_GT";
+    case RPNOpcode::CMP_LT: return "CMP_LT";
+    case RPNOpcode::CMP_NE: return "CMP_NE";
+    case RPNOpcode::NEG: return "NEG";
+    case RPNOpcode::ASSIGN: return "ASSIGN";
+    case RPNOpcode::ARRAY_ASSIGN: return "ARRAY_ASSIGN";
+    case RPNOpcode::ARRAY_LOAD: return "ARRAY_LOAD";
+    case RPNOpcode::JUMP: return "JUMP";
+    case RPNOpcode::JUMP_FALSE: return "JUMP_FALSE";
+    case RPNOpcode::INPUT: return "INPUT";
+    case RPNOpcode::INPUT_ARRAY: return "INPUT_ARRAY";
+    case RPNOpcode::OUTPUT: return "OUTPUT";
+    case RPNOpcode::SIN: return "SIN";
+    case RPNOpcode::COS: return "COS";
+    case RPNOpcode::TG: return "TG";
+    case RPNOpcode::CTG: return "CTG";
+    case RPNOpcode::LOAD_ADD_CONST: return "LOAD_ADD_CONST";
+    case RPNOpcode::LOAD_ARRAY_VAR: return "LOAD_ARRAY_VAR";
+    case RPNOpcode::JUMP_FALSE_EQ: return "JUMP_FALSE_EQ";
+    case RPNOpcode::JUMP_FALSE_GT: return "JUMP_FALSE_GT";
+    case RPNOpcode::JUMP_FALSE_LT: return "JUMP_FALSE_LT";
+    case RPNOpcode::JUMP_FALSE_NE: return "JUMP_FALSE_NE";
+    case RPNOpcode::ARRAY_ASSIGN_UNCHECKED: return "ARRAY_ASSIGN_UNCHECKED";
+    case RPNOpcode::ARRAY_LOAD_UNCHECKED: return "ARRAY_LOAD_UNCHECKED";
+    case RPNOpcode::LOAD_ARRAY_VAR_UNCHECKED: return "LOAD_ARRAY_VAR_UNCHECKED";
+    }
+    return "UNKNOWN";
+}
+
+// Арифметика языка - по модулю 2^32: переполнение int в C++ - неопределённое поведение, поэтому
+// все движки, свёртка констант и сгенерированный C (rt_add и др.) считают в unsigned; JIT получает
+// то же поведение от машинных команд
+inline int wrapping_add(int a, int b) { return static_cast<int>(static_cast<unsigned int>(a) + static_cast<unsigned int>(b)); }
+inline int wrapping_sub(int a, int b) { return static_cast<int>(static_cast<unsigned int>(a) - static_cast<unsigned int>(b)); }
+inline int wrapping_mul(int a, int b) { return static_cast<int>(static_cast<unsigned int>(a) * static_cast<unsigned int>(b)); }
+inline int wrapping_neg(int a) { return static_cast<int>(0u - static_cast<unsigned int>(a)); }
+
+bool rpn_is_jump(RPNOpcode op)
+{
+    switch (op)
+    {
+    case RPNOpcode::JUMP:
+    case RPNOpcode::JUMP_FALSE:
+    case RPNOpcode::JUMP_FALSE_EQ:
+    case RPNOpcode::JUMP_FALSE_GT:
+    case RPNOpcode::JUMP_FALSE_LT:
+    case RPNOpcode::JUMP_FALSE_NE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Stack depths before every RPN entry, checked for underflow and for consistency at jump targets
+struct RPNStackLayout
+{
+    std::vector<int> value_depth; // value_depth[pc] = values on stack before m_rpn[pc]; one extra entry for the end
+    std::vector<int> ref_depth;
+    int max_value_depth = 0;
+    int max_ref_depth = 0;
+};
+
+RPNStackLayout compute_stack_layout(const std::vector<RPNEntry> &rpn)
+{
+    RPNStackLayout layout;
+    layout.value_depth.resize(rpn.size() + 1, 0);
+    layout.ref_depth.resize(rpn.size() + 1, 0);
+    int values = 0, refs = 0;
+    for (size_t pc = 0; pc < rpn.size(); ++pc)
+    {
+        layout.value_depth[pc] = values;
+        layout.ref_depth[pc] = refs;
+        RPNStackEffect effect = rpn_stack_effect(rpn[pc].opcode);
+        if (values < effect.pop_values || refs < effect.pop_refs)
+        {
+            throw std::runtime_error("Interpreter Setup Error: Operand stack underflow at RPN PC " + std::to_string(pc) +
+                                     " (source line " + std::to_string(rpn[pc].line_num) + ").");
+        }
+        values += effect.push_values - effect.pop_values;
+        refs += effect.push_refs - effect.pop_refs;
+        layout.max_value_depth = std::max(layout.max_value_depth, values);
+        layout.max_ref_depth = std::max(layout.max_ref_depth, refs);
+    }
+    layout.value_depth[rpn.size()] = values;
+    layout.ref_depth[rpn.size()] = refs;
+
+    // Straight-line depths are only valid if every jump lands with the same depth it leaves with
+    for (size_t pc = 0; pc < rpn.size(); ++pc)
+    {
+        const RPNEntry &entry = rpn[pc];
+        if (!rpn_is_jump(entry.opcode))
+            continue;
+        if (entry.operand < 0 || static_cast<size_t>(entry.operand) > rpn.size())
+            continue; // Reported separately by the caller
+        int values_after = layout.value_depth[pc] - rpn_stack_effect(entry.opcode).pop_values;
+        if (layout.value_depth[entry.operand] != values_after || layout.ref_depth[entry.operand] != layout.ref_depth[pc])
+        {
+            throw std::runtime_error("Interpreter Setup Error: Inconsistent operand stack depth at jump target " + std::to_string(entry.operand) +
+                                     " (jump at RPN PC " + std::to_string(pc) + ").");
+        }
+    }
+    return layout;
+}
+
 enum class SymbolClass
 {
     UNKNOWN,
@@ -566,120 +1093,183 @@ struct SymbolInfo
     int size = 0; // For arrays
     int declaration_line = 0;
     bool is_declared = false;
+    int slot = -1; // Dense index: variables and arrays are numbered separately
+    std::string name;
+};
+
+// Declared symbols in declaration order
+typedef std::vector<SymbolInfo> SymbolTable;
+
+// Токены для парсера читаются из лексера по одному, по требованию: в памяти только текущий
+// токен (один токен предпросмотра), поэтому длина программы не ограничена
+class TokenStream
+{
+public:
+    // dump: if set, every token is listed there as it is read
+    TokenStream(Lexer &lexer, const StringInterner &pool, std::ostream *dump = nullptr)
+        : m_lexer(lexer), m_pool(pool), m_dump(dump), m_count(0), m_hasCurrent(false) {}
+
+    const Token &peek()
+    {
+        if (!m_hasCurrent)
+            fill();
+        return m_current;
+    }
+
+    Token next()
+    {
+        Token t = peek();
+        if (t.code != EOF_TOK) // EOF is sticky
+            m_hasCurrent = false;
+        return t;
+    }
+
+    const StringInterner &pool() const { return m_pool; }
+    size_t count() const { return m_count; }
+
+private:
+    Lexer &m_lexer;
+    const StringInterner &m_pool;
+    std::ostream *m_dump;
+    size_t m_count;
+    Token m_current;
+    bool m_hasCurrent;
+
+    void fill()
+    {
+        do
+        {
+            m_current = m_lexer.getNextToken();
+        } while (m_current.code == NONE_TOK); // Internal empty states of the lexer
+        m_hasCurrent = true;
+        ++m_count;
+        if (m_dump)
+            *m_dump << "  " << m_current.codeToString() << " : \"" << m_current.lexeme(m_pool) << "\" (Line: " << m_current.line << ")" << std::endl;
+        if (m_current.code == ERROR_TOK)
+            throw std::runtime_error("Лексический анализ остановлен из-за ошибки (Line " + std::to_string(m_current.line) + ").");
+    }
 };
 
 // --- RPN Generator Class ---
 class RPNGenerator
 {
 public:
-    RPNGenerator(const std::vector<Token> &tokens)
-        : m_tokens(tokens), m_currentIndex(0), m_labelCounter(0) {}
+    RPNGenerator(TokenStream &tokens)
+        : m_tokens(tokens), m_pool(tokens.pool()), m_symbolByLexeme(tokens.pool().arena().resource()), m_varSlotCount(0), m_arraySlotCount(0) {}
 
+    // Single pass: tokens are pulled from the stream while parsing
     std::vector<RPNEntry> generate()
     {
         m_rpn.clear();
         m_symbolTable.clear();
-        m_currentIndex = 0;
-        m_labelCounter = 0;
-        if (m_tokens.empty() || m_tokens.back().code != EOF_TOK)
-        {
-            throw std::runtime_error("Parser Error: Token stream is empty or does not end with EOF_TOK.");
-        }
+        m_symbolByLexeme.clear();
+        m_varSlotCount = 0;
+        m_arraySlotCount = 0;
         parse_P();
         if (currentToken().code != EOF_TOK)
         {
-            throwError("Expected end of program (EOF_TOK) but found " + currentToken().codeToString() + " ('" + currentToken().lexeme + "')");
+            throwError("Expected end of program (EOF_TOK) but found " + currentToken().codeToString() + " ('" + text(currentToken()) + "')");
         }
-        return m_rpn;
+        return std::move(m_rpn);
     }
-    const std::map<std::string, SymbolInfo> &getSymbolTable() const { return m_symbolTable; }
+    const SymbolTable &getSymbolTable() const { return m_symbolTable; }
+    SymbolTable takeSymbolTable() { return std::move(m_symbolTable); }
 
 private:
-    const std::vector<Token> &m_tokens;
-    size_t m_currentIndex;
+    TokenStream &m_tokens;
+    const StringInterner &m_pool;
     std::vector<RPNEntry> m_rpn;
-    std::map<std::string, SymbolInfo> m_symbolTable;
-    int m_labelCounter;
-
-    Token currentToken()
-    {
-        if (m_currentIndex < m_tokens.size())
-            return m_tokens[m_currentIndex];
-        if (!m_tokens.empty() && m_tokens.back().code == EOF_TOK)
-            return m_tokens.back();
-        throw std::runtime_error("Parser Error: Unexpected end of token stream (currentToken).");
-    }
-    Token consumeToken()
-    {
-        if (m_currentIndex < m_tokens.size())
-        {
-            if (m_tokens[m_currentIndex].code == EOF_TOK && (m_currentIndex + 1 < m_tokens.size()))
-            {
+    SymbolTable m_symbolTable;
+    std::pmr::vector<int> m_symbolByLexeme; // Lexeme id -> index in m_symbolTable, -1 if not declared; lives in the arena
+    int m_varSlotCount;
+    int m_arraySlotCount;
 
-                throw std::runtime_error("Parser Error: Attempt to consume EOF_TOK when more tokens exist.");
-            }
-            return m_tokens[m_currentIndex++];
-        }
+    std::string text(const Token &t) const { return std::string(t.lexeme(m_pool)); }
 
-        throw std::runtime_error("Parser Error: Unexpected end of token stream (consumeToken).");
-    }
-    Token expect(TokenCode expectedCode, const std::string &errorMessagePrefix)
+    const Token &currentToken() { return m_tokens.peek(); }
+    Token consumeToken() { return m_tokens.next(); }
+    // The context is a plain C string so that the common, successful path does not build a std::string
+    Token expect(TokenCode expectedCode, const char *errorMessagePrefix)
     {
         Token t = consumeToken();
         if (t.code != expectedCode)
         {
-            Token tempExpected(expectedCode, "");
-            throwError(errorMessagePrefix + ". Expected " + tempExpected.codeToString() +
-                       " but got " + t.codeToString() + " ('" + t.lexeme + "')");
+            Token tempExpected(expectedCode);
+            throwError(std::string(errorMessagePrefix) + ". Expected " + tempExpected.codeToString() +
+                       " but got " + t.codeToString() + " ('" + text(t) + "')");
         }
         return t;
     }
     void throwError(const std::string &message)
     {
-        int line = 0;
-        if (m_currentIndex < m_tokens.size())
+        int line = currentToken().line;
+        throw std::runtime_error("Syntax Error (Line " + std::to_string(line) + "): " + message);
+    }
+    // Emits a jump with an unknown target; the caller backpatches it once the block is closed
+    size_t emitJump(RPNItemType type, int line)
+    {
+        m_rpn.emplace_back(type, type == RPNItemType::JUMP ? RPNOpcode::JUMP : RPNOpcode::JUMP_FALSE, "", line);
+        return m_rpn.size() - 1;
+    }
+    void patchJump(size_t jump_index, size_t target)
+    {
+        m_rpn[jump_index].operand = static_cast<int>(target);
+    }
+
+    // Константы декодируются один раз при генерации, а не при каждом выполнении
+    int parseConstant(const Token &num_tok)
+    {
+        try
         {
-            line = m_tokens[m_currentIndex].line;
+            return std::stoi(text(num_tok));
         }
-        else if (m_currentIndex > 0 && m_currentIndex <= m_tokens.size())
+        catch (const std::out_of_range &)
         {
-            line = m_tokens[m_currentIndex - 1].line;
+            throwError("Invalid constant (too large/small): '" + text(num_tok) + "'");
         }
-        throw std::runtime_error("Syntax Error (Line " + std::to_string(line) + "): " + message);
+        catch (const std::invalid_argument &)
+        {
+            throwError("Invalid constant (not a number): '" + text(num_tok) + "'");
+        }
+        return 0;
     }
-    std::string newLabel()
+
+    // Symbols are found by lexeme id, without comparing strings
+    int findSymbol(const Token &id) const
     {
-        std::stringstream ss;
-        ss << "L" << m_labelCounter++;
-        return ss.str();
+        if (id.lexeme_id < 0 || static_cast<size_t>(id.lexeme_id) >= m_symbolByLexeme.size())
+            return -1;
+        return m_symbolByLexeme[id.lexeme_id];
     }
-
-    void addSymbol(const std::string &name, SymbolClass s_class, TokenCode type, int line, int arr_size = 0)
+    void addSymbol(const Token &id, SymbolClass s_class, TokenCode type, int line, int arr_size = 0)
     {
-        if (m_symbolTable.count(name) && m_symbolTable[name].is_declared)
+        int existing = findSymbol(id);
+        if (existing >= 0)
         {
-            throwError("Identifier '" + name + "' already declared at line " + std::to_string(m_symbolTable[name].declaration_line) + ".");
+            throwError("Identifier '" + text(id) + "' already declared at line " + std::to_string(m_symbolTable[existing].declaration_line) + ".");
         }
-        m_symbolTable[name] = {s_class, type, arr_size, line, true};
+        int slot = (s_class == SymbolClass::INT_ARRAY) ? m_arraySlotCount++ : m_varSlotCount++;
+        if (m_symbolByLexeme.size() <= static_cast<size_t>(id.lexeme_id))
+            m_symbolByLexeme.resize(id.lexeme_id + 1, -1);
+        m_symbolByLexeme[id.lexeme_id] = static_cast<int>(m_symbolTable.size());
+        m_symbolTable.push_back({s_class, type, arr_size, line, true, slot, text(id)});
     }
-    SymbolInfo getSymbol(const std::string &name, int use_line)
+    const SymbolInfo &getSymbol(const Token &id)
     {
-        auto it = m_symbolTable.find(name);
-        if (it == m_symbolTable.end() || !it->second.is_declared)
+        int index = findSymbol(id);
+        if (index < 0)
         {
-            throwError("Undeclared identifier '" + name + "' used at line " + std::to_string(use_line) + ".");
+            throwError("Undeclared identifier '" + text(id) + "' used at line " + std::to_string(id.line) + ".");
         }
-        return it->second;
+        return m_symbolTable[index];
     }
 
     // P → int LE | arr ME | begin A end
     void parse_P()
     {
         TokenCode tc = currentToken().code;
-        if (tc == INT_TOK)
-            parse_int_LE();
-        else if (tc == IMAS_TOK)
-            parse_arr_ME();
+        if (tc == INT_TOK || tc == IMAS_TOK)
+            parse_E();
         else if (tc == BEG_TOK)
         {
             consumeToken();
@@ -691,14 +1281,20 @@ private:
     }
 
     // E → int LE | arr ME | begin A end | λ
+    // LE и ME заканчиваются на E, поэтому список объявлений разбирается циклом, а не рекурсией
     void parse_E()
     {
-        TokenCode tc = currentToken().code;
-        if (tc == INT_TOK)
-            parse_int_LE();
-        else if (tc == IMAS_TOK)
-            parse_arr_ME();
-        else if (tc == BEG_TOK)
+        for (;;)
+        {
+            TokenCode tc = currentToken().code;
+            if (tc == INT_TOK)
+                parse_int_LE();
+            else if (tc == IMAS_TOK)
+                parse_arr_ME();
+            else
+                break;
+        }
+        if (currentToken().code == BEG_TOK)
         {
             consumeToken();
             parse_A();
@@ -708,15 +1304,14 @@ private:
     }
 
     void parse_int_LE()
-    { // int a; E
+    { // int a; (E is parsed by the caller)
         expect(INT_TOK, "int declaration");
         Token id = expect(ID_TOK, "identifier after 'int'");
-        addSymbol(id.lexeme, SymbolClass::INT_VAR, INT_TOK, id.line);
+        addSymbol(id, SymbolClass::INT_VAR, INT_TOK, id.line);
         expect(SEMICOLON_TOK, "after int declaration");
-        parse_E();
     }
     void parse_arr_ME()
-    { // arr a[k]; E
+    { // arr a[k]; (E is parsed by the caller)
         expect(IMAS_TOK, "array declaration ('arr')");
         Token id = expect(ID_TOK, "identifier after 'arr'");
         expect(LBRACKET_TOK, "for array size");
@@ -724,143 +1319,187 @@ private:
         int array_size = 0;
         try
         {
-            array_size = std::stoi(size_tok.lexeme);
+            array_size = std::stoi(text(size_tok));
         }
         catch (const std::out_of_range &)
         {
-            throwError("Array size number too large: " + size_tok.lexeme);
+            throwError("Array size number too large: " + text(size_tok));
         }
         catch (const std::invalid_argument &)
         {
-            throwError("Invalid number for array size: " + size_tok.lexeme);
+            throwError("Invalid number for array size: " + text(size_tok));
         }
         if (array_size <= 0)
-            throwError("Array size must be positive for '" + id.lexeme + "'.");
+            throwError("Array size must be positive for '" + text(id) + "'.");
         expect(RBRACKET_TOK, "after array size");
-        addSymbol(id.lexeme, SymbolClass::INT_ARRAY, IMAS_TOK, id.line, array_size);
+        addSymbol(id, SymbolClass::INT_ARRAY, IMAS_TOK, id.line, array_size);
         expect(SEMICOLON_TOK, "after array declaration");
-        parse_E();
     }
 
+    // An if/while block whose statement list is being parsed; A only nests through these
+    struct OpenBlock
+    {
+        enum Kind
+        {
+            IF_THEN,
+            IF_ELSE,
+            WHILE_BODY
+        } kind;
+        size_t pending_jump; // JUMP_FALSE past the then-branch / JUMP past the else-branch / loop exit
+        size_t loop_start;   // WHILE_BODY only
+        int line;
+    };
+
     // A → aH = G ; A | if ( C ) begin AX ; A | while ( C ) begin A end ; A | cin (aH) ; A | cout ( G ) ; A | λ
+    // Хвост "; A" разбирается циклом, вложенность if/while хранится в явном стеке блоков,
+    // так что глубина стека C++ не зависит ни от длины программы, ни от вложенности блоков.
     void parse_A()
     {
-        Token t = currentToken();
-        if (t.code == ID_TOK)
+        std::vector<OpenBlock> blocks;
+        for (;;)
         {
-            Token id_token = consumeToken();
-            bool is_array_target = false;
-            SymbolInfo sym_info = getSymbol(id_token.lexeme, id_token.line);
-
-            if (currentToken().code == LBRACKET_TOK)
+            Token t = currentToken();
+            if (t.code == ID_TOK)
+                parse_assignment();
+            else if (t.code == IF_TOK)
             {
-                if (sym_info.s_class != SymbolClass::INT_ARRAY)
-                    throwError("'" + id_token.lexeme + "' is not an array.");
-                is_array_target = true;
-                m_rpn.emplace_back(RPNItemType::ARRAY_BASE, id_token.lexeme, id_token.line);
                 consumeToken();
-                parse_G();
-                expect(RBRACKET_TOK, "array index in assignment LHS");
+                expect(LPAREN_TOK, "after 'if'");
+                parse_C();
+                expect(RPAREN_TOK, "after 'if' condition");
+                size_t jump_to_else = emitJump(RPNItemType::JUMP_FALSE, t.line);
+                expect(BEG_TOK, "'if' block");
+                blocks.push_back({OpenBlock::IF_THEN, jump_to_else, 0, t.line});
             }
-            else
+            else if (t.code == WHILE_TOK)
             {
-                if (sym_info.s_class == SymbolClass::INT_ARRAY)
-                    throwError("Cannot assign to array '" + id_token.lexeme + "' as a whole.");
-                m_rpn.emplace_back(RPNItemType::VAR, id_token.lexeme, id_token.line);
+                consumeToken();
+                size_t loop_start = m_rpn.size();
+                expect(LPAREN_TOK, "after 'while'");
+                parse_C();
+                expect(RPAREN_TOK, "after 'while' condition");
+                size_t jump_to_end = emitJump(RPNItemType::JUMP_FALSE, t.line);
+                expect(BEG_TOK, "'while' block");
+                blocks.push_back({OpenBlock::WHILE_BODY, jump_to_end, loop_start, t.line});
             }
-            expect(EQ_TOK, "assignment");
-            parse_G();
-            m_rpn.emplace_back(RPNItemType::OPERATION, (is_array_target ? "[]=" : "="), t.line);
-            expect(SEMICOLON_TOK, "after assignment");
-            parse_A();
+            else if (t.code == INPUT_TOK)
+                parse_input();
+            else if (t.code == OUTPUT_TOK)
+                parse_output();
+            // Убираем обработку тригонометрических функций как операторов - они теперь только в выражениях
+            // λ case: the innermost statement list ends here
+            else if (blocks.empty())
+                return; // currentToken() is END_TOK or part of an outer structure
+            else
+                closeBlock(blocks);
         }
-        else if (t.code == IF_TOK)
-        {
-            consumeToken();
-            expect(LPAREN_TOK, "after 'if'");
-            parse_C();
-            expect(RPAREN_TOK, "after 'if' condition");
-            std::string else_label = newLabel(), end_if_label = newLabel();
-            m_rpn.emplace_back(RPNItemType::JUMP_FALSE, else_label, t.line);
-            expect(BEG_TOK, "'if' block");
-            parse_A();
+    }
 
+    // Called when the statement list of blocks.back() ends; consumes the block's tail
+    void closeBlock(std::vector<OpenBlock> &blocks)
+    {
+        OpenBlock block = blocks.back();
+        blocks.pop_back();
+        switch (block.kind)
+        {
+        case OpenBlock::IF_THEN:
+            expect(END_TOK, "'if' block");
             if (currentToken().code == ELSE_TOK)
             {
-                expect(END_TOK, "before 'else'");
-                m_rpn.emplace_back(RPNItemType::JUMP, end_if_label, currentToken().line);
-                m_rpn.emplace_back(RPNItemType::LABEL_DEF, else_label, currentToken().line);
+                size_t jump_to_end = emitJump(RPNItemType::JUMP, currentToken().line);
+                patchJump(block.pending_jump, m_rpn.size());
                 consumeToken();
                 expect(BEG_TOK, "'else' block");
-                parse_A();
-                expect(END_TOK, "'else' block");
-                m_rpn.emplace_back(RPNItemType::LABEL_DEF, end_if_label, currentToken().line);
-            }
-            else
-            {
-                expect(END_TOK, "'if' block (no else)");
-                m_rpn.emplace_back(RPNItemType::LABEL_DEF, else_label, t.line); // else_label is where execution continues if condition was false
+                blocks.push_back({OpenBlock::IF_ELSE, jump_to_end, 0, block.line});
+                return;
             }
+            patchJump(block.pending_jump, m_rpn.size()); // Execution continues here if condition was false
             expect(SEMICOLON_TOK, "after 'if' statement");
-            parse_A();
-        }
-        else if (t.code == WHILE_TOK)
-        {
-            consumeToken();
-            std::string loop_start = newLabel(), loop_end = newLabel();
-            m_rpn.emplace_back(RPNItemType::LABEL_DEF, loop_start, t.line);
-            expect(LPAREN_TOK, "after 'while'");
-            parse_C();
-            expect(RPAREN_TOK, "after 'while' condition");
-            m_rpn.emplace_back(RPNItemType::JUMP_FALSE, loop_end, t.line);
-            expect(BEG_TOK, "'while' block");
-            parse_A();
+            break;
+        case OpenBlock::IF_ELSE:
+            expect(END_TOK, "'else' block");
+            patchJump(block.pending_jump, m_rpn.size());
+            expect(SEMICOLON_TOK, "after 'if' statement");
+            break;
+        case OpenBlock::WHILE_BODY:
             expect(END_TOK, "'while' block");
-            m_rpn.emplace_back(RPNItemType::JUMP, loop_start, t.line);
-            m_rpn.emplace_back(RPNItemType::LABEL_DEF, loop_end, t.line);
+            patchJump(emitJump(RPNItemType::JUMP, block.line), block.loop_start);
+            patchJump(block.pending_jump, m_rpn.size());
             expect(SEMICOLON_TOK, "after 'while' statement");
-            parse_A();
+            break;
         }
-        else if (t.code == INPUT_TOK)
+    }
+
+    // aH = G ;
+    void parse_assignment()
+    {
+        Token id_token = consumeToken();
+        bool is_array_target = false;
+        const SymbolInfo &sym_info = getSymbol(id_token);
+
+        if (currentToken().code == LBRACKET_TOK)
         {
+            if (sym_info.s_class != SymbolClass::INT_ARRAY)
+                throwError("'" + text(id_token) + "' is not an array.");
+            is_array_target = true;
+            m_rpn.emplace_back(RPNItemType::ARRAY_BASE, RPNOpcode::PUSH_ARRAY, text(id_token), id_token.line, sym_info.slot);
             consumeToken();
-            expect(LPAREN_TOK, "after 'cin'");
-            Token id_token = expect(ID_TOK, "identifier for 'cin'");
-            SymbolInfo sym_info = getSymbol(id_token.lexeme, id_token.line);
-            if (currentToken().code == LBRACKET_TOK)
-            {
-                if (sym_info.s_class != SymbolClass::INT_ARRAY)
-                    throwError("'" + id_token.lexeme + "' is not an array for cin[].");
-                m_rpn.emplace_back(RPNItemType::ARRAY_BASE, id_token.lexeme, id_token.line);
-                consumeToken();
-                parse_G();
-                expect(RBRACKET_TOK, "array index in 'cin'");
-                m_rpn.emplace_back(RPNItemType::INPUT, "IN[]", t.line);
-            }
-            else
-            {
-                if (sym_info.s_class == SymbolClass::INT_ARRAY)
-                    throwError("Cannot 'cin' into array '" + id_token.lexeme + "' as a whole.");
-                m_rpn.emplace_back(RPNItemType::VAR, id_token.lexeme, id_token.line);
-                m_rpn.emplace_back(RPNItemType::INPUT, "IN", t.line);
-            }
-            expect(RPAREN_TOK, "after 'cin' target");
-            expect(SEMICOLON_TOK, "after 'cin' statement");
-            parse_A();
+            parse_G();
+            expect(RBRACKET_TOK, "array index in assignment LHS");
         }
-        else if (t.code == OUTPUT_TOK)
+        else
         {
-            consumeToken();
-            expect(LPAREN_TOK, "after 'cout'");
-            parse_G();
-            expect(RPAREN_TOK, "after 'cout' expression");
-            m_rpn.emplace_back(RPNItemType::OUTPUT, "OUT", t.line);
-            expect(SEMICOLON_TOK, "after 'cout' statement");
-            parse_A();
+            if (sym_info.s_class == SymbolClass::INT_ARRAY)
+                throwError("Cannot assign to array '" + text(id_token) + "' as a whole.");
+            m_rpn.emplace_back(RPNItemType::VAR_REF, RPNOpcode::PUSH_VAR_REF, text(id_token), id_token.line, sym_info.slot);
         }
-        // Убираем обработку тригонометрических функций как операторов - они теперь только в выражениях
-        // λ case: if currentToken() is END_TOK or part of an outer structure
-    }
+        expect(EQ_TOK, "assignment");
+        parse_G();
+        if (is_array_target)
+            m_rpn.emplace_back(RPNItemType::OPERATION, RPNOpcode::ARRAY_ASSIGN, "[]=", id_token.line);
+        else
+            m_rpn.emplace_back(RPNItemType::OPERATION, RPNOpcode::ASSIGN, "=", id_token.line);
+        expect(SEMICOLON_TOK, "after assignment");
+    }
+
+    // cin ( aH ) ;
+    void parse_input()
+    {
+        Token t = consumeToken();
+        expect(LPAREN_TOK, "after 'cin'");
+        Token id_token = expect(ID_TOK, "identifier for 'cin'");
+        const SymbolInfo &sym_info = getSymbol(id_token);
+        if (currentToken().code == LBRACKET_TOK)
+        {
+            if (sym_info.s_class != SymbolClass::INT_ARRAY)
+                throwError("'" + text(id_token) + "' is not an array for cin[].");
+            m_rpn.emplace_back(RPNItemType::ARRAY_BASE, RPNOpcode::PUSH_ARRAY, text(id_token), id_token.line, sym_info.slot);
+            consumeToken();
+            parse_G();
+            expect(RBRACKET_TOK, "array index in 'cin'");
+            m_rpn.emplace_back(RPNItemType::INPUT, RPNOpcode::INPUT_ARRAY, "IN[]", t.line);
+        }
+        else
+        {
+            if (sym_info.s_class == SymbolClass::INT_ARRAY)
+                throwError("Cannot 'cin' into array '" + text(id_token) + "' as a whole.");
+            m_rpn.emplace_back(RPNItemType::VAR_REF, RPNOpcode::PUSH_VAR_REF, text(id_token), id_token.line, sym_info.slot);
+            m_rpn.emplace_back(RPNItemType::INPUT, RPNOpcode::INPUT, "IN", t.line);
+        }
+        expect(RPAREN_TOK, "after 'cin' target");
+        expect(SEMICOLON_TOK, "after 'cin' statement");
+    }
+
+    // cout ( G ) ;
+    void parse_output()
+    {
+        Token t = consumeToken();
+        expect(LPAREN_TOK, "after 'cout'");
+        parse_G();
+        expect(RPAREN_TOK, "after 'cout' expression");
+        m_rpn.emplace_back(RPNItemType::OUTPUT, RPNOpcode::OUTPUT, "OUT", t.line);
+        expect(SEMICOLON_TOK, "after 'cout' statement");
+    }
 
     // G → T U'
     void parse_G()
@@ -868,16 +1507,14 @@ private:
         parse_T();
         parse_U_prime();
     }
-    // U' → + T U' | - T U' | λ
+    // U' → + T U' | - T U' | λ  (хвостовая рекурсия развёрнута в цикл)
     void parse_U_prime()
     {
-        Token t = currentToken();
-        if (t.code == PLUS_TOK || t.code == MINUS_TOK)
+        for (Token t = currentToken(); t.code == PLUS_TOK || t.code == MINUS_TOK; t = currentToken())
         {
             consumeToken();
             parse_T();
-            m_rpn.emplace_back(RPNItemType::OPERATION, t.lexeme, t.line);
-            parse_U_prime();
+            m_rpn.emplace_back(RPNItemType::OPERATION, t.code == PLUS_TOK ? RPNOpcode::ADD : RPNOpcode::SUB, text(t), t.line);
         }
     }
     // T → F V'
@@ -886,18 +1523,17 @@ private:
         parse_F();
         parse_V_prime();
     }
-    // V' → * F V' | / F V' | λ
+    // V' → * F V' | / F V' | λ  (хвостовая рекурсия развёрнута в цикл)
     void parse_V_prime()
     {
-        Token t = currentToken();
-        if (t.code == STAR_TOK || t.code == SLASH_TOK)
+        for (Token t = currentToken(); t.code == STAR_TOK || t.code == SLASH_TOK; t = currentToken())
         {
             consumeToken();
             parse_F();
-            m_rpn.emplace_back(RPNItemType::OPERATION, t.lexeme, t.line);
-            parse_V_prime();
+            m_rpn.emplace_back(RPNItemType::OPERATION, t.code == STAR_TOK ? RPNOpcode::MUL : RPNOpcode::DIV, text(t), t.line);
         }
     }
+
     // F → (G) | aH | k | sin(G) | cos(G) | tg(G) | ctg(G) | -F
     void parse_F()
     {
@@ -911,28 +1547,29 @@ private:
         else if (t.code == ID_TOK)
         {
             Token id_token = consumeToken();
-            SymbolInfo sym_info = getSymbol(id_token.lexeme, id_token.line);
+            const SymbolInfo &sym_info = getSymbol(id_token);
             if (currentToken().code == LBRACKET_TOK)
             {
                 if (sym_info.s_class != SymbolClass::INT_ARRAY)
-                    throwError("'" + id_token.lexeme + "' is not an array for indexing.");
-                m_rpn.emplace_back(RPNItemType::ARRAY_BASE, id_token.lexeme, id_token.line);
+                    throwError("'" + text(id_token) + "' is not an array for indexing.");
+                m_rpn.emplace_back(RPNItemType::ARRAY_BASE, RPNOpcode::PUSH_ARRAY, text(id_token), id_token.line, sym_info.slot);
                 consumeToken();
                 parse_G();
                 expect(RBRACKET_TOK, "array index in expression");
-                m_rpn.emplace_back(RPNItemType::ARRAY_ACCESS, "[]", t.line);
+                m_rpn.emplace_back(RPNItemType::ARRAY_ACCESS, RPNOpcode::ARRAY_LOAD, "[]", t.line);
             }
             else
             {
                 if (sym_info.s_class == SymbolClass::INT_ARRAY)
-                    throwError("Cannot use array '" + id_token.lexeme + "' as simple value.");
-                m_rpn.emplace_back(RPNItemType::VAR, id_token.lexeme, id_token.line);
+                    throwError("Cannot use array '" + text(id_token) + "' as simple value.");
+                m_rpn.emplace_back(RPNItemType::VAR, RPNOpcode::LOAD_VAR, text(id_token), id_token.line, sym_info.slot);
             }
         }
         else if (t.code == NUM_TOK)
         {
+            int value = parseConstant(t);
             consumeToken();
-            m_rpn.emplace_back(RPNItemType::CONST, t.lexeme, t.line);
+            m_rpn.emplace_back(RPNItemType::CONST, RPNOpcode::PUSH_CONST, text(t), t.line, value);
         }
         else if (t.code == SIN_TOK || t.code == COS_TOK || t.code == TG_TOK || t.code == CTG_TOK)
         {
@@ -944,32 +1581,37 @@ private:
             expect(RPAREN_TOK, "after trigonometric function argument");
 
             std::string func_name;
+            RPNOpcode func_op = RPNOpcode::SIN;
             switch (func_code)
             {
             case SIN_TOK:
                 func_name = "sin";
+                func_op = RPNOpcode::SIN;
                 break;
             case COS_TOK:
                 func_name = "cos";
+                func_op = RPNOpcode::COS;
                 break;
             case TG_TOK:
                 func_name = "tg";
+                func_op = RPNOpcode::TG;
                 break;
             case CTG_TOK:
                 func_name = "ctg";
+                func_op = RPNOpcode::CTG;
                 break;
             default:
                 throwError("Unknown trigonometric function");
             }
 
-            m_rpn.emplace_back(RPNItemType::TRIG_FUNCTION, func_name, t.line);
+            m_rpn.emplace_back(RPNItemType::TRIG_FUNCTION, func_op, func_name, t.line);
         }
         else if (t.code == MINUS_TOK)
         {
             // Обработка унарного минуса
             consumeToken();
             parse_F(); // Рекурсивно парсим следующий фактор
-            m_rpn.emplace_back(RPNItemType::OPERATION, "unary-", t.line);
+            m_rpn.emplace_back(RPNItemType::OPERATION, RPNOpcode::NEG, "unary-", t.line);
         }
         else
         {
@@ -983,24 +1625,29 @@ private:
         parse_G();
         Token op_tok = currentToken();
         std::string op_str;
+        RPNOpcode op_code = RPNOpcode::CMP_EQ;
         if (op_tok.code == EQ_COMPARE_TOK)
         {
             op_str = "~";
+            op_code = RPNOpcode::CMP_EQ;
             consumeToken();
         }
         else if (op_tok.code == GT_TOK)
         {
             op_str = ">";
+            op_code = RPNOpcode::CMP_GT;
             consumeToken();
         }
         else if (op_tok.code == LT_TOK)
         {
             op_str = "<";
+            op_code = RPNOpcode::CMP_LT;
             consumeToken();
         }
         else if (op_tok.code == NOT_TOK)
         {
             op_str = "!";
+            op_code = RPNOpcode::CMP_NE;
             consumeToken();
         }
         else
@@ -1008,593 +1655,5384 @@ private:
             throwError("Expected relational operator (~, >, <, !) in condition, found " + op_tok.codeToString());
         }
         parse_G();
-        m_rpn.emplace_back(RPNItemType::OPERATION, op_str, op_tok.line);
+        m_rpn.emplace_back(RPNItemType::OPERATION, op_code, op_str, op_tok.line);
     }
 };
 
-// RPN Interpreter Class
-class RPNInterpreter
+// --- Ввод/вывод и тригонометрия (общие для всех механизмов выполнения) ---
+
+// Пакетный режим (--batch): приглашения не печатаются, весь stdin читается в буфер заранее,
+// а строки "Output: N" копятся блоками и сбрасываются одним вызовом write при заполнении блока,
+// в конце выполнения или перед сообщением об ошибке.
+class BatchIO
 {
 public:
-    RPNInterpreter(const std::vector<RPNEntry> &rpn, const std::map<std::string, SymbolInfo> &symbolTable)
-        : m_rpn(rpn), m_symbolTable(symbolTable), m_pc(0)
+    static constexpr size_t kOutputBlockSize = 64 * 1024;
+
+    bool enabled() const { return m_enabled; }
+
+    // Reads the rest of `in` when the program has cin at all, so that a program without input does not
+    // wait for EOF on a terminal. Input and output buffers are set up here so that run() does not allocate.
+    void enable(std::istream &in, bool read_input)
     {
-        // Pre-populate variables and arrays from symbol table
-        for (const auto &sym_pair : m_symbolTable)
-        {
-            const std::string &name = sym_pair.first;
-            const SymbolInfo &info = sym_pair.second;
-            if (info.is_declared)
-            { // Ensure it was actually declared
-                if (info.s_class == SymbolClass::INT_VAR)
-                {
-                    m_variables[name] = 0; // Default initialize to 0
-                }
-                else if (info.s_class == SymbolClass::INT_ARRAY)
-                {
-                    m_arrays[name] = std::vector<int>(info.size, 0); // Default initialize elements to 0
-                }
-            }
-        }
-        // Build label map
-        for (size_t i = 0; i < m_rpn.size(); ++i)
-        {
-            if (m_rpn[i].type == RPNItemType::LABEL_DEF)
-            {
-                if (m_labelMap.count(m_rpn[i].value))
-                {
-                    throw std::runtime_error("Interpreter Setup Error: Duplicate label definition '" + m_rpn[i].value + "'. This should be caught by parser.");
-                }
-                m_labelMap[m_rpn[i].value] = i;
-            }
-        }
+        m_enabled = true;
+        char chunk[64 * 1024];
+        while (read_input && (in.read(chunk, sizeof chunk) || in.gcount() > 0))
+            m_input.append(chunk, static_cast<size_t>(in.gcount()));
+        in.clear();
+        m_output.resize(kOutputBlockSize);
     }
 
-    void run()
+    // Integers are separated by any whitespace, not one per line as in interactive mode
+    int readInt()
     {
-        m_pc = 0;
-        m_operandStack.clear();
-
-        while (m_pc < m_rpn.size())
+        const char *p = m_input.data() + m_inputPos;
+        const char *end = m_input.data() + m_input.size();
+        while (p != end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == '\v' || *p == '\f'))
+            ++p;
+        bool negative = false;
+        if (p != end && (*p == '-' || *p == '+'))
+            negative = (*p++ == '-');
+        long long value = 0;
+        const char *digits = p;
+        while (p != end && *p >= '0' && *p <= '9')
         {
-            const RPNEntry &entry = m_rpn[m_pc];
-            // For debugging:
-            // std::cout << "Executing PC " << m_pc << ": " << entry.typeToString() << " \"" << entry.value
-            //           << "\" (Line: " << entry.line_num << ")" << std::endl;
+            value = value * 10 + (*p++ - '0');
+            if (value > static_cast<long long>(std::numeric_limits<int>::max()) + 1)
+                break;
+        }
+        if (negative)
+            value = -value;
+        if (p == digits || value < std::numeric_limits<int>::min() || value > std::numeric_limits<int>::max())
+            throw std::runtime_error("Invalid input, integer expected.");
+        m_inputPos = static_cast<size_t>(p - m_input.data());
+        return static_cast<int>(value);
+    }
 
-            bool increment_pc = true;
+    void writeOutput(int val)
+    {
+        static const char prefix[] = "Output: ";
+        const size_t max_line = sizeof prefix - 1 + 11 + 1; // "-2147483648\n"
+        if (m_outputSize + max_line > m_output.size())
+            flush();
+        char *out = m_output.data() + m_outputSize;
+        std::memcpy(out, prefix, sizeof prefix - 1);
+        out += sizeof prefix - 1;
+        out = std::to_chars(out, m_output.data() + m_output.size(), val).ptr;
+        *out++ = '\n';
+        m_outputSize = static_cast<size_t>(out - m_output.data());
+    }
 
-            try
-            {
-                switch (entry.type)
-                {
-                case RPNItemType::VAR:
-                    // VAR RPN item means "push variable NAME" onto operand stack.
-                    // Subsequent operations (like arithmetic or assignment) will resolve this name to a value or use it as a target.
-                    m_operandStack.push_back(entry.value);
-                    break;
+    void flush()
+    {
+        if (m_outputSize == 0)
+            return;
+        std::cout.write(m_output.data(), static_cast<std::streamsize>(m_outputSize));
+        std::cout.flush();
+        m_outputSize = 0;
+    }
 
-                case RPNItemType::ARRAY_BASE:
-                    // ARRAY_BASE RPN item means "push array NAME" onto operand stack.
-                    m_operandStack.push_back(entry.value);
-                    break;
+private:
+    bool m_enabled = false;
+    std::string m_input;
+    size_t m_inputPos = 0;
+    std::vector<char> m_output;
+    size_t m_outputSize = 0;
+};
 
-                case RPNItemType::CONST:
-                    try
-                    {
-                        m_operandStack.push_back(std::stoi(entry.value));
-                    }
-                    catch (const std::out_of_range &)
-                    {
-                        throw std::runtime_error("Invalid constant (too large/small): '" + entry.value + "'");
-                    }
-                    catch (const std::invalid_argument &)
-                    {
-                        throw std::runtime_error("Invalid constant (not a number): '" + entry.value + "'");
-                    }
-                    break;
+static BatchIO g_batchIO;
 
-                case RPNItemType::OPERATION:
-                    handle_operation(entry);
-                    break;
+bool program_reads_input(const std::vector<RPNEntry> &rpn)
+{
+    return std::any_of(rpn.begin(), rpn.end(), [](const RPNEntry &entry)
+                       { return entry.type == RPNItemType::INPUT; });
+}
 
-                case RPNItemType::LABEL_DEF:
-                    // NOP during execution, handled in constructor
-                    break;
+int read_input_value()
+{
+    if (g_batchIO.enabled())
+        return g_batchIO.readInt();
+    int val;
+    std::cout << "Input (integer): ";
+    if (!(std::cin >> val))
+    {
+        std::cin.clear();
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        throw std::runtime_error("Invalid input, integer expected.");
+    }
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    return val;
+}
 
-                case RPNItemType::JUMP:
-                    m_pc = find_label(entry.value, entry.line_num);
-                    increment_pc = false; // PC is set directly, don't increment at the end
-                    break;
+void write_output_value(int val)
+{
+    if (g_batchIO.enabled())
+    {
+        g_batchIO.writeOutput(val);
+        return;
+    }
+    std::cout << "Output: " << val << std::endl;
+}
 
-                case RPNItemType::JUMP_FALSE:
-                {
-                    StackItem condition_item = pop_operand();
-                    int condition = get_int(condition_item, "Condition for JUMP_FALSE");
-                    if (condition == 0)
-                    { // If condition is false (0)
-                        m_pc = find_label(entry.value, entry.line_num);
-                        increment_pc = false;
-                    }
-                    break;
-                }
+// Аргумент в градусах, результат округляется до целого
+int evaluate_trig_function_libm(RPNOpcode func, int arg)
+{
+    double arg_val = static_cast<double>(arg);
 
-                case RPNItemType::ARRAY_ACCESS: // "[]" operation
-                    handle_array_access(entry);
-                    break;
+    // Преобразуем градусы в радианы для стандартных функций
+    double arg_radians = arg_val * M_PI / 180.0;
+    double result = 0.0;
 
-                    // RPNItemType::ARRAY_ASSIGN is not used; "[]=" is an OPERATION.
+    switch (func)
+    {
+    case RPNOpcode::SIN:
+        result = std::sin(arg_radians);
+        break;
+    case RPNOpcode::COS:
+        result = std::cos(arg_radians);
+        break;
+    case RPNOpcode::TG:
+        result = std::tan(arg_radians);
+        break;
+    case RPNOpcode::CTG:
+    {
+        double tan_val = std::tan(arg_radians);
+        if (std::abs(tan_val) < 1e-15)
+        {
+            throw std::runtime_error("Cotangent undefined for angle " + std::to_string(arg_val) + " degrees (tan = 0)");
+        }
+        result = 1.0 / tan_val;
+        break;
+    }
+    default:
+        throw std::runtime_error("Unknown trigonometric function (opcode " + std::to_string(static_cast<int>(func)) + ")");
+    }
 
-                case RPNItemType::INPUT:
-                    handle_input(entry);
-                    break;
+    // Округляем результат до целого числа
+    return static_cast<int>(std::round(result));
+}
 
-                case RPNItemType::OUTPUT:
-                    handle_output(entry);
-                    break;
+// Таблицы значений для целых градусов. Одного периода недостаточно: радианы для 30 и 390 градусов
+// отличаются в последних битах, и после округления sin(30) = 0, а sin(-330) = 1. Поэтому таблица
+// покрывает окно [-kLimit, kLimit] и заполняется той же функцией, что и раньше; вне окна — libm.
+struct TrigTables
+{
+    static const int kLimit = 720;
+    static const int kSize = 2 * kLimit + 1;
 
-                case RPNItemType::TRIG_FUNCTION:
-                    handle_trig_function(entry);
-                    break;
+    int values[4][kSize];      // SIN, COS, TG, CTG
+    bool ctg_undefined[kSize]; // tan is (almost) zero: evaluating ctg must raise the error
 
-                default:
-                    throw std::runtime_error("Unknown RPN item type: " + entry.typeToString());
-                }
-            }
-            catch (const std::runtime_error &e)
+    TrigTables()
+    {
+        const RPNOpcode funcs[4] = {RPNOpcode::SIN, RPNOpcode::COS, RPNOpcode::TG, RPNOpcode::CTG};
+        for (int i = 0; i < kSize; ++i)
+        {
+            int degrees = i - kLimit;
+            for (int f = 0; f < 3; ++f)
+                values[f][i] = evaluate_trig_function_libm(funcs[f], degrees);
+            try
             {
-                // Augment error with line number from RPN entry
-                throw std::runtime_error("Interpreter Error (Source Line " + std::to_string(entry.line_num) +
-                                         ", RPN PC " + std::to_string(m_pc) + "): " + e.what());
+                values[3][i] = evaluate_trig_function_libm(RPNOpcode::CTG, degrees);
+                ctg_undefined[i] = false;
             }
-
-            if (increment_pc)
+            catch (const std::runtime_error &)
             {
-                m_pc++;
+                values[3][i] = 0;
+                ctg_undefined[i] = true;
             }
-            // Debug operand stack:
-            // print_operand_stack_debug();
         }
     }
+};
 
-private:
-    using StackItem = std::variant<int, std::string>;
-    std::vector<StackItem> m_operandStack;
-    std::map<std::string, int> m_variables;
-    std::map<std::string, std::vector<int>> m_arrays;
-    std::map<std::string, size_t> m_labelMap;
-
-    const std::vector<RPNEntry> &m_rpn;
-    const std::map<std::string, SymbolInfo> &m_symbolTable;
-    size_t m_pc;
+static const TrigTables g_trigTables;
 
-    void push_operand(StackItem val) { m_operandStack.push_back(val); }
-    StackItem pop_operand()
+int evaluate_trig_function(RPNOpcode func, int arg)
+{
+    if (arg < -TrigTables::kLimit || arg > TrigTables::kLimit)
+        return evaluate_trig_function_libm(func, arg);
+    int i = arg + TrigTables::kLimit;
+    switch (func)
     {
-        if (m_operandStack.empty())
-        {
-            throw std::runtime_error("Operand stack underflow.");
-        }
-        StackItem val = m_operandStack.back();
-        m_operandStack.pop_back();
-        return val;
+    case RPNOpcode::SIN:
+        return g_trigTables.values[0][i];
+    case RPNOpcode::COS:
+        return g_trigTables.values[1][i];
+    case RPNOpcode::TG:
+        return g_trigTables.values[2][i];
+    case RPNOpcode::CTG:
+        if (g_trigTables.ctg_undefined[i])
+            return evaluate_trig_function_libm(func, arg); // Raises the "Cotangent undefined" error
+        return g_trigTables.values[3][i];
+    default:
+        return evaluate_trig_function_libm(func, arg);
     }
+}
+
+// Микробенчмарк: таблицы против libm на одних и тех же аргументах; заодно сверяет все значения окна
+bool run_trig_benchmark()
+{
+    const RPNOpcode funcs[4] = {RPNOpcode::SIN, RPNOpcode::COS, RPNOpcode::TG, RPNOpcode::CTG};
+    const char *names[4] = {"sin", "cos", "tg", "ctg"};
+    const int rounds = 200;
 
-    int get_int(const StackItem &item, const std::string &context)
+    int mismatches = 0;
+    for (int f = 0; f < 4; ++f)
     {
-        if (std::holds_alternative<int>(item))
+        for (int arg = -TrigTables::kLimit - 10; arg <= TrigTables::kLimit + 10; ++arg)
         {
-            return std::get<int>(item);
-        }
-        else if (std::holds_alternative<std::string>(item))
-        {
-            const std::string &var_name = std::get<std::string>(item);
-            auto it_var = m_variables.find(var_name);
-            if (it_var != m_variables.end())
+            std::string table_result, libm_result;
+            try
             {
-                return it_var->second;
+                table_result = std::to_string(evaluate_trig_function(funcs[f], arg));
             }
-            // It's not a simple variable, check if it's an array name (which shouldn't be directly converted to int here)
-            // This situation typically means an array name was used where a value was expected without indexing.
-            // The parser should catch most of these, but a runtime check is good.
-            if (m_arrays.count(var_name))
+            catch (const std::runtime_error &e)
             {
-                throw std::runtime_error("Cannot use array '" + var_name + "' as a simple integer value for " + context +
-                                         ". Array must be indexed.");
+                table_result = e.what();
             }
-            throw std::runtime_error("Undeclared identifier or uninitialized variable '" + var_name + "' used as integer for " + context + ".");
-        }
-        throw std::runtime_error("Invalid type on operand stack for " + context + ". Expected int or resolvable variable name.");
-    }
-
-    std::string get_string(const StackItem &item, const std::string &context)
-    {
-        if (std::holds_alternative<std::string>(item))
-        {
-            return std::get<std::string>(item);
-        }
-        // If an int is found where a string (name) was expected.
-        int int_val = 0;
-        if (std::holds_alternative<int>(item))
-            int_val = std::get<int>(item);
-        throw std::runtime_error("Invalid type on operand stack for " + context + ". Expected string (identifier name), but found " +
-                                 (std::holds_alternative<int>(item) ? "integer " + std::to_string(int_val) : "unknown type") + ".");
-    }
-
-    void handle_operation(const RPNEntry &entry)
-    {
-        const std::string &op = entry.value;
-
-        if (op == "=")
-        {
-            StackItem rhs_item = pop_operand();
-            StackItem lhs_item = pop_operand();
-
-            int val_to_assign = get_int(rhs_item, "RHS of assignment");
-            std::string var_name = get_string(lhs_item, "LHS of assignment (variable name)");
-
-            if (m_variables.find(var_name) == m_variables.end())
+            try
             {
-                // Check if it's an array name - cannot assign to entire array this way
-                if (m_arrays.count(var_name))
-                {
-                    throw std::runtime_error("Cannot assign to array '" + var_name + "' as a whole. Use indexed assignment.");
-                }
-                throw std::runtime_error("Assignment to undeclared variable '" + var_name + "'.");
+                libm_result = std::to_string(evaluate_trig_function_libm(funcs[f], arg));
             }
-            m_variables[var_name] = val_to_assign;
-        }
-        else if (op == "[]=")
-        {
-            StackItem val_item = pop_operand();
-            StackItem idx_item = pop_operand();
-            StackItem arr_name_item = pop_operand();
-
-            int value_to_assign = get_int(val_item, "Value for array assignment");
-            int index = get_int(idx_item, "Index for array assignment");
-            std::string array_name = get_string(arr_name_item, "Array name for assignment");
-
-            auto it = m_arrays.find(array_name);
-            if (it == m_arrays.end())
+            catch (const std::runtime_error &e)
             {
-                throw std::runtime_error("Assignment to undeclared array '" + array_name + "'.");
+                libm_result = e.what();
             }
-            if (index < 0 || static_cast<size_t>(index) >= it->second.size())
+            if (table_result != libm_result)
             {
-                throw std::runtime_error("Array index " + std::to_string(index) + " out of bounds for array '" + array_name +
-                                         "' (size " + std::to_string(it->second.size()) + ").");
+                std::cout << "  Mismatch: " << names[f] << "(" << arg << "): table " << table_result << ", libm " << libm_result << std::endl;
+                ++mismatches;
             }
-            it->second[index] = value_to_assign;
-        }
-        else if (op == "unary-")
-        {
-            // Обработка унарного минуса
-            StackItem operand_item = pop_operand();
-            int operand = get_int(operand_item, "Operand for unary minus");
-            push_operand(-operand);
         }
-        else
+    }
+
+    std::cout << "--- Бенчмарк тригонометрии (" << rounds << " x " << (2 * TrigTables::kLimit + 1) << " аргументов) ---" << std::endl;
+    for (int f = 0; f < 3; ++f) // ctg throws on multiples of 180 and would measure exception handling
+    {
+        long long checksum[2] = {0, 0};
+        double seconds[2];
+        for (int engine = 0; engine < 2; ++engine)
         {
-            StackItem rhs_item = pop_operand();
-            StackItem lhs_item = pop_operand();
-
-            int b = get_int(rhs_item, "RHS of operation '" + op + "'");
-            int a = get_int(lhs_item, "LHS of operation '" + op + "'");
-            int result = 0;
-
-            if (op == "+")
-                result = a + b;
-            else if (op == "-")
-                result = a - b;
-            else if (op == "*")
-                result = a * b;
-            else if (op == "/")
-            {
-                if (b == 0)
-                    throw std::runtime_error("Division by zero.");
-                result = a / b;
-            }
-            else if (op == "~")
-                result = (a == b ? 1 : 0); // Return 1 for true, 0 for false
-            else if (op == ">")
-                result = (a > b ? 1 : 0);
-            else if (op == "<")
-                result = (a < b ? 1 : 0);
-            else if (op == "!")
-                result = (a != b ? 1 : 0); // Not equal
-            else
+            auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < rounds; ++r)
             {
-                throw std::runtime_error("Unknown arithmetic/logical operator '" + op + "'.");
+                for (int arg = -TrigTables::kLimit; arg <= TrigTables::kLimit; ++arg)
+                    checksum[engine] += engine == 0 ? evaluate_trig_function(funcs[f], arg) : evaluate_trig_function_libm(funcs[f], arg);
             }
-            push_operand(result);
+            seconds[engine] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
         }
+        std::cout << "  " << names[f] << ": table " << seconds[0] << " s, libm " << seconds[1] << " s";
+        if (seconds[0] > 0)
+            std::cout << ", speedup " << seconds[1] / seconds[0] << "x";
+        std::cout << (checksum[0] == checksum[1] ? "" : " (CHECKSUM MISMATCH)") << std::endl;
+        if (checksum[0] != checksum[1])
+            ++mismatches;
     }
+    std::cout << "  Mismatches: " << mismatches << std::endl;
+    std::cout << "--- Конец бенчмарка ---" << std::endl;
+    return mismatches == 0;
+}
 
-    void handle_array_access(const RPNEntry &entry)
+// --- Оптимизация ОПЗ ---
+
+// Marks entries that some jump lands on: passes must not merge such an entry into the one before it
+std::vector<bool> rpn_jump_targets(const std::vector<RPNEntry> &rpn)
+{
+    std::vector<bool> is_target(rpn.size() + 1, false);
+    for (const RPNEntry &entry : rpn)
     {
-        StackItem idx_item = pop_operand();
-        StackItem arr_name_item = pop_operand();
+        if (rpn_is_jump(entry.opcode) && entry.operand >= 0 && static_cast<size_t>(entry.operand) <= rpn.size())
+            is_target[entry.operand] = true;
+    }
+    return is_target;
+}
 
-        int index = get_int(idx_item, "Index for array access");
-        std::string array_name = get_string(arr_name_item, "Array name for access");
+// Drops the entries marked in `removed` and renumbers jump targets.
+// A jump to a removed entry lands on the next entry that is kept.
+void compact_rpn(std::vector<RPNEntry> &rpn, const std::vector<bool> &removed)
+{
+    std::vector<int> new_index(rpn.size() + 1);
+    int kept = 0;
+    for (size_t i = 0; i < rpn.size(); ++i)
+    {
+        new_index[i] = kept;
+        if (!removed[i])
+            ++kept;
+    }
+    new_index[rpn.size()] = kept;
 
-        auto it = m_arrays.find(array_name);
-        if (it == m_arrays.end())
-        {
-            throw std::runtime_error("Access to undeclared array '" + array_name + "'.");
-        }
-        if (index < 0 || static_cast<size_t>(index) >= it->second.size())
-        {
-            throw std::runtime_error("Array index " + std::to_string(index) + " out of bounds for array '" + array_name +
-                                     "' (size " + std::to_string(it->second.size()) + ").");
-        }
-        push_operand(it->second[index]);
+    size_t out = 0;
+    for (size_t i = 0; i < rpn.size(); ++i)
+    {
+        if (removed[i])
+            continue;
+        if (rpn_is_jump(rpn[i].opcode))
+            rpn[i].operand = new_index[rpn[i].operand];
+        if (out != i)
+            rpn[out] = std::move(rpn[i]);
+        ++out;
     }
+    rpn.erase(rpn.begin() + out, rpn.end());
+}
 
-    void handle_input(const RPNEntry &entry)
+struct RPNFoldingReport
+{
+    size_t entries_before = 0;
+    size_t entries_after = 0;
+    int folded = 0;     // Operations on constants replaced by their result
+    int identities = 0; // x+0, x-0, x*1, x/1, x*0 (x without side effects)
+};
+
+// Свёртка констант и алгебраические упрощения. Работает в пределах линейного участка: на цели перехода
+// всё, что известно о стеке, сбрасывается. Операции, которые упали бы во время выполнения (деление на ноль,
+// INT_MIN / -1, неопределённый ctg), не сворачиваются и выдают свою ошибку как раньше.
+RPNFoldingReport fold_constants(std::vector<RPNEntry> &rpn)
+{
+    RPNFoldingReport report;
+    report.entries_before = rpn.size();
+    std::vector<bool> is_target = rpn_jump_targets(rpn);
+    std::vector<bool> removed(rpn.size(), false);
+
+    // What is known about a value on the operand stack; its RPN occupies [first, pc of the producer]
+    struct Value
+    {
+        bool is_const;
+        int value;
+        bool pure; // No side effects and cannot fail, so it may be dropped
+        size_t first;
+    };
+    std::vector<Value> stack;
+
+    // An expression range can be dropped if no jump lands inside it and it holds only value computations
+    auto removable = [&](size_t from, size_t to)
     {
-        const std::string &input_type = entry.value; // "IN" or "IN[]"
-        int val;
-        std::cout << "Input (integer): ";
-        if (!(std::cin >> val))
+        for (size_t i = from; i <= to; ++i)
         {
-            std::cin.clear();
-            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-            throw std::runtime_error("Invalid input, integer expected.");
+            if ((i > from && is_target[i]) ||
+                (!removed[i] && (rpn[i].opcode == RPNOpcode::PUSH_VAR_REF || rpn[i].opcode == RPNOpcode::PUSH_ARRAY)))
+                return false;
         }
-        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        return true;
+    };
+    auto remove = [&](size_t from, size_t to)
+    {
+        for (size_t i = from; i <= to; ++i)
+            removed[i] = true;
+    };
+    // Replaces [from, pc] with a single constant at pc
+    auto fold_to = [&](size_t from, size_t pc, int value)
+    {
+        if (from < pc && !removable(from, pc))
+            return false;
+        if (from < pc)
+            remove(from, pc - 1);
+        rpn[pc] = RPNEntry(RPNItemType::CONST, RPNOpcode::PUSH_CONST, std::to_string(value), rpn[pc].line_num, value);
+        stack.push_back({true, value, true, from});
+        return true;
+    };
 
-        if (input_type == "IN")
+    for (size_t pc = 0; pc < rpn.size(); ++pc)
+    {
+        if (is_target[pc])
         {
-            StackItem var_name_item = pop_operand();
-            std::string var_name = get_string(var_name_item, "Target variable for input");
-            if (m_variables.find(var_name) == m_variables.end())
-            {
-                if (m_arrays.count(var_name))
-                { // Check if it's an array name
-                    throw std::runtime_error("Cannot 'cin' into array '" + var_name + "' as a whole. Use indexed input.");
-                }
-                throw std::runtime_error("Input to undeclared variable '" + var_name + "'.");
-            }
-            m_variables[var_name] = val;
+            for (Value &v : stack)
+                v.is_const = v.pure = false;
         }
-        else if (input_type == "IN[]")
+        const RPNOpcode op = rpn[pc].opcode;
+        switch (op)
+        {
+        case RPNOpcode::PUSH_CONST:
+            stack.push_back({true, rpn[pc].operand, true, pc});
+            break;
+        case RPNOpcode::LOAD_VAR:
+            stack.push_back({false, 0, true, pc});
+            break;
+        case RPNOpcode::ADD:
+        case RPNOpcode::SUB:
+        case RPNOpcode::MUL:
+        case RPNOpcode::DIV:
+        case RPNOpcode::CMP_EQ:
+        case RPNOpcode::CMP_GT:
+        case RPNOpcode::CMP_LT:
+        case RPNOpcode::CMP_NE:
         {
-            StackItem idx_item = pop_operand();
-            StackItem arr_name_item = pop_operand();
+            Value b = stack.back();
+            stack.pop_back();
+            Value a = stack.back();
+            stack.pop_back();
 
-            int index = get_int(idx_item, "Index for array input");
-            std::string array_name = get_string(arr_name_item, "Array name for input");
+            if (a.is_const && b.is_const)
+            {
+                long long x = a.value, y = b.value;
+                bool can_fold = true;
+                int result = 0;
+                switch (op)
+                {
+                case RPNOpcode::ADD:
+                    result = wrapping_add(a.value, b.value);
+                    break;
+                case RPNOpcode::SUB:
+                    result = wrapping_sub(a.value, b.value);
+                    break;
+                case RPNOpcode::MUL:
+                    result = wrapping_mul(a.value, b.value);
+                    break;
+                case RPNOpcode::DIV:
+                    can_fold = y != 0 && !(x == std::numeric_limits<int>::min() && y == -1);
+                    if (can_fold)
+                        result = a.value / b.value;
+                    break;
+                case RPNOpcode::CMP_EQ:
+                    result = x == y;
+                    break;
+                case RPNOpcode::CMP_GT:
+                    result = x > y;
+                    break;
+                case RPNOpcode::CMP_LT:
+                    result = x < y;
+                    break;
+                default:
+                    result = x != y;
+                    break;
+                }
+                if (can_fold && fold_to(a.first, pc, result))
+                {
+                    report.folded++;
+                    break;
+                }
+            }
 
-            auto it = m_arrays.find(array_name);
-            if (it == m_arrays.end())
+            // Identities: the constant operand and the operation disappear, the other operand stays
+            bool keep_a = b.is_const && ((b.value == 0 && (op == RPNOpcode::ADD || op == RPNOpcode::SUB)) ||
+                                         (b.value == 1 && (op == RPNOpcode::MUL || op == RPNOpcode::DIV)));
+            bool keep_b = a.is_const && ((a.value == 0 && op == RPNOpcode::ADD) || (a.value == 1 && op == RPNOpcode::MUL));
+            if (keep_a && removable(b.first, pc))
             {
-                throw std::runtime_error("Input to undeclared array '" + array_name + "'.");
+                remove(b.first, pc);
+                stack.push_back(a);
+                report.identities++;
+                break;
             }
-            if (index < 0 || static_cast<size_t>(index) >= it->second.size())
+            if (keep_b && removable(a.first, b.first - 1) && !is_target[pc])
             {
-                throw std::runtime_error("Array index " + std::to_string(index) + " out of bounds for input to array '" + array_name +
-                                         "' (size " + std::to_string(it->second.size()) + ").");
+                remove(a.first, b.first - 1);
+                removed[pc] = true;
+                stack.push_back({b.is_const, b.value, b.pure, a.first});
+                report.identities++;
+                break;
             }
-            it->second[index] = val;
-        }
-        else
-        {
-            throw std::runtime_error("Unknown input type '" + input_type + "'.");
-        }
-    }
-
-    void handle_output(const RPNEntry &entry)
-    {
-        StackItem val_item = pop_operand();
-        int val_to_print = get_int(val_item, "Value for output");
-        std::cout << "Output: " << val_to_print << std::endl;
-    }
-
-    void handle_trig_function(const RPNEntry &entry)
-    {
-        StackItem arg_item = pop_operand();
-        double arg_val = static_cast<double>(get_int(arg_item, "Argument for trigonometric function '" + entry.value + "'"));
-
-        // Преобразуем градусы в радианы для стандартных функций
-        double arg_radians = arg_val * M_PI / 180.0;
-        double result = 0.0;
-
-        const std::string &func_name = entry.value;
-        if (func_name == "sin")
-        {
-            result = std::sin(arg_radians);
-        }
-        else if (func_name == "cos")
-        {
-            result = std::cos(arg_radians);
+            // x*0 and 0*x drop x only if evaluating it has no effect
+            if (op == RPNOpcode::MUL && ((b.is_const && b.value == 0 && a.pure) || (a.is_const && a.value == 0 && b.pure)) &&
+                fold_to(a.first, pc, 0))
+            {
+                report.identities++;
+                break;
+            }
+            stack.push_back({false, 0, a.pure && b.pure && op != RPNOpcode::DIV, a.first});
+            break;
         }
-        else if (func_name == "tg")
+        case RPNOpcode::NEG:
         {
-            result = std::tan(arg_radians);
+            Value a = stack.back();
+            stack.pop_back();
+            if (a.is_const && fold_to(a.first, pc, wrapping_neg(a.value)))
+            {
+                report.folded++;
+                break;
+            }
+            stack.push_back({false, 0, a.pure, a.first});
+            break;
         }
-        else if (func_name == "ctg")
+        case RPNOpcode::SIN:
+        case RPNOpcode::COS:
+        case RPNOpcode::TG:
+        case RPNOpcode::CTG:
         {
-            double tan_val = std::tan(arg_radians);
-            if (std::abs(tan_val) < 1e-15)
+            Value a = stack.back();
+            stack.pop_back();
+            if (a.is_const)
             {
-                throw std::runtime_error("Cotangent undefined for angle " + std::to_string(arg_val) + " degrees (tan = 0)");
+                bool defined = true;
+                int result = 0;
+                try
+                {
+                    result = evaluate_trig_function(op, a.value);
+                }
+                catch (const std::runtime_error &)
+                {
+                    defined = false; // ctg of a multiple of 180: left for the run-time error
+                }
+                if (defined && fold_to(a.first, pc, result))
+                {
+                    report.folded++;
+                    break;
+                }
             }
-            result = 1.0 / tan_val;
+            stack.push_back({false, 0, a.pure && op != RPNOpcode::CTG, a.first});
+            break;
         }
-        else
+        default:
         {
-            throw std::runtime_error("Unknown trigonometric function '" + func_name + "'");
+            RPNStackEffect effect = rpn_stack_effect(op);
+            if (static_cast<int>(stack.size()) < effect.pop_values)
+                throw std::runtime_error("Optimizer Error: Operand stack underflow at RPN PC " + std::to_string(pc) + ".");
+            stack.resize(stack.size() - effect.pop_values);
+            for (int i = 0; i < effect.push_values; ++i)
+                stack.push_back({false, 0, false, pc});
+            break;
         }
-
-        // Округляем результат до целого числа
-        int int_result = static_cast<int>(std::round(result));
-        push_operand(int_result);
-
-        // Убираем вывод отладочной информации при выполнении функции
-        // std::cout << "Trigonometric function " << func_name << "(" << arg_val << "°) = " << result << " (rounded to " << int_result << ")" << std::endl;
-    }
-
-    size_t find_label(const std::string &label_name, int source_line_for_error)
-    {
-        auto it = m_labelMap.find(label_name);
-        if (it == m_labelMap.end())
-        {
-            throw std::runtime_error("Undefined label '" + label_name + "' targeted by jump from source line " + std::to_string(source_line_for_error) + ".");
         }
-        return it->second;
     }
 
-    void print_operand_stack_debug()
+    compact_rpn(rpn, removed);
+    report.entries_after = rpn.size();
+    return report;
+}
+
+// Базовые блоки ОПЗ. Переходы задают цель индексом записи, поэтому блок начинается с записи 0,
+// с цели перехода или с записи после перехода и тянется до начала следующего блока.
+struct RPNBasicBlock
+{
+    size_t begin; // First entry
+    size_t end;   // One past the last entry
+    std::vector<int> successors; // Block indices; running off the end of the program is not a block
+};
+
+struct RPNControlFlowGraph
+{
+    std::vector<RPNBasicBlock> blocks; // In program order
+    std::vector<int> block_at;         // Entry index -> block starting there or -1; rpn.size() + 1 entries
+};
+
+RPNControlFlowGraph build_rpn_cfg(const std::vector<RPNEntry> &rpn)
+{
+    RPNControlFlowGraph cfg;
+    cfg.block_at.assign(rpn.size() + 1, -1);
+    std::vector<bool> is_leader = rpn_jump_targets(rpn);
+    for (size_t pc = 0; pc < rpn.size(); ++pc)
+    {
+        if (rpn_is_jump(rpn[pc].opcode))
+            is_leader[pc + 1] = true;
+    }
+    for (size_t pc = 0; pc < rpn.size(); ++pc)
+    {
+        if (pc != 0 && !is_leader[pc])
+            continue;
+        if (!cfg.blocks.empty())
+            cfg.blocks.back().end = pc;
+        cfg.block_at[pc] = static_cast<int>(cfg.blocks.size());
+        cfg.blocks.push_back({pc, rpn.size(), {}});
+    }
+    for (RPNBasicBlock &block : cfg.blocks)
+    {
+        const RPNEntry &last = rpn[block.end - 1];
+        if (last.opcode != RPNOpcode::JUMP && cfg.block_at[block.end] >= 0)
+            block.successors.push_back(cfg.block_at[block.end]);
+        if (rpn_is_jump(last.opcode) && last.operand >= 0 && static_cast<size_t>(last.operand) <= rpn.size() &&
+            cfg.block_at[last.operand] >= 0)
+            block.successors.push_back(cfg.block_at[last.operand]);
+    }
+    return cfg;
+}
+
+struct RPNDeadCodeReport
+{
+    size_t entries_before = 0;
+    size_t entries_after = 0;
+    int folded_branches = 0;    // JUMP_FALSE on a constant: dropped or turned into JUMP
+    int unreachable_blocks = 0; // Blocks no path from the first entry reaches
+    int redundant_jumps = 0;    // JUMP whose target is where execution falls through once removed entries are skipped
+    int dead_stores = 0;        // x = E; where x is not read afterwards and E cannot fail
+};
+
+// Computes a value without side effects and without a way to fail at run time
+bool rpn_is_pure_value_op(RPNOpcode op)
+{
+    switch (op)
+    {
+    case RPNOpcode::PUSH_CONST:
+    case RPNOpcode::LOAD_VAR:
+    case RPNOpcode::ADD:
+    case RPNOpcode::SUB:
+    case RPNOpcode::MUL:
+    case RPNOpcode::NEG:
+    case RPNOpcode::CMP_EQ:
+    case RPNOpcode::CMP_GT:
+    case RPNOpcode::CMP_LT:
+    case RPNOpcode::CMP_NE:
+    case RPNOpcode::SIN:
+    case RPNOpcode::COS:
+    case RPNOpcode::TG:
+    case RPNOpcode::LOAD_ADD_CONST:
+        return true;
+    default: // DIV and CTG may stop the program, array accesses may be out of bounds
+        return false;
+    }
+}
+
+// Drops blocks no path from the first entry reaches, and JUMPs left with nothing but removed entries before their target
+bool eliminate_dead_blocks(std::vector<RPNEntry> &rpn, RPNDeadCodeReport &report)
+{
+    const RPNControlFlowGraph cfg = build_rpn_cfg(rpn);
+    std::vector<bool> reached(cfg.blocks.size(), false);
+    std::vector<int> pending;
+    if (!cfg.blocks.empty())
+    {
+        reached[0] = true;
+        pending.push_back(0);
+    }
+    while (!pending.empty())
+    {
+        int b = pending.back();
+        pending.pop_back();
+        for (int successor : cfg.blocks[b].successors)
+        {
+            if (!reached[successor])
+            {
+                reached[successor] = true;
+                pending.push_back(successor);
+            }
+        }
+    }
+
+    std::vector<bool> removed(rpn.size(), false);
+    bool changed = false;
+    for (size_t b = 0; b < cfg.blocks.size(); ++b)
+    {
+        if (reached[b])
+            continue;
+        for (size_t pc = cfg.blocks[b].begin; pc < cfg.blocks[b].end; ++pc)
+            removed[pc] = true;
+        report.unreachable_blocks++;
+        changed = true;
+    }
+    // Everything between the jump and its target is gone: execution falls through to the target anyway
+    for (size_t pc = 0; pc < rpn.size(); ++pc)
+    {
+        if (removed[pc] || rpn[pc].opcode != RPNOpcode::JUMP || rpn[pc].operand <= static_cast<int>(pc))
+            continue;
+        size_t next = pc + 1;
+        while (next < static_cast<size_t>(rpn[pc].operand) && removed[next])
+            ++next;
+        if (next == static_cast<size_t>(rpn[pc].operand))
+        {
+            removed[pc] = true;
+            report.redundant_jumps++;
+            changed = true;
+        }
+    }
+    compact_rpn(rpn, removed);
+    return changed;
+}
+
+// Backward liveness of variables over the CFG; a store not followed by a read of its variable on any path is dead
+bool eliminate_dead_stores(std::vector<RPNEntry> &rpn, RPNDeadCodeReport &report)
+{
+    const std::vector<bool> is_target = rpn_jump_targets(rpn);
+    size_t variable_count = 0;
+    for (const RPNEntry &entry : rpn)
+    {
+        if (entry.opcode == RPNOpcode::PUSH_VAR_REF || entry.opcode == RPNOpcode::LOAD_VAR || entry.opcode == RPNOpcode::LOAD_ADD_CONST)
+            variable_count = std::max(variable_count, static_cast<size_t>(entry.operand) + 1);
+        else if (entry.opcode == RPNOpcode::LOAD_ARRAY_VAR || entry.opcode == RPNOpcode::LOAD_ARRAY_VAR_UNCHECKED)
+            variable_count = std::max(variable_count, static_cast<size_t>(entry.operand2) + 1);
+    }
+
+    // Variable written by each ASSIGN/INPUT, and where a removable `x = E;` starts (its PUSH_VAR_REF)
+    const size_t kNone = std::numeric_limits<size_t>::max();
+    std::vector<int> store_slot(rpn.size(), -1);
+    std::vector<size_t> store_begin(rpn.size(), kNone);
+    std::vector<int> refs;
+    for (size_t pc = 0; pc < rpn.size(); ++pc)
+    {
+        const RPNEntry &entry = rpn[pc];
+        if (entry.opcode == RPNOpcode::PUSH_VAR_REF || entry.opcode == RPNOpcode::PUSH_ARRAY)
+        {
+            refs.push_back(entry.opcode == RPNOpcode::PUSH_VAR_REF ? entry.operand : -1);
+            if (entry.opcode == RPNOpcode::PUSH_ARRAY)
+                continue;
+            size_t end = pc + 1;
+            while (end < rpn.size() && !is_target[end] && rpn_is_pure_value_op(rpn[end].opcode))
+                ++end;
+            if (end < rpn.size() && !is_target[end] && rpn[end].opcode == RPNOpcode::ASSIGN)
+                store_begin[end] = pc;
+            continue;
+        }
+        int pops = rpn_stack_effect(entry.opcode).pop_refs;
+        if (static_cast<int>(refs.size()) < pops)
+            throw std::runtime_error("Optimizer Error: Reference stack underflow at RPN PC " + std::to_string(pc) + ".");
+        if (pops > 0 && (entry.opcode == RPNOpcode::ASSIGN || entry.opcode == RPNOpcode::INPUT))
+            store_slot[pc] = refs.back();
+        refs.resize(refs.size() - pops);
+    }
+
+    // live: variables that may be read before being written again; scans [begin, end) backwards
+    auto transfer = [&](char *live, size_t begin, size_t end)
+    {
+        for (size_t pc = end; pc-- > begin;)
+        {
+            const RPNEntry &entry = rpn[pc];
+            if (store_slot[pc] >= 0)
+                live[store_slot[pc]] = 0;
+            else if (entry.opcode == RPNOpcode::LOAD_VAR || entry.opcode == RPNOpcode::LOAD_ADD_CONST)
+                live[entry.operand] = 1;
+            else if (entry.opcode == RPNOpcode::LOAD_ARRAY_VAR || entry.opcode == RPNOpcode::LOAD_ARRAY_VAR_UNCHECKED)
+                live[entry.operand2] = 1;
+        }
+    };
+
+    // One flat row of variable_count flags per block
+    const RPNControlFlowGraph cfg = build_rpn_cfg(rpn);
+    std::vector<char> live_in(cfg.blocks.size() * variable_count, 0);
+    std::vector<char> live(variable_count);
+    auto live_out = [&](size_t b)
+    {
+        std::fill(live.begin(), live.end(), 0); // Nothing is read after the program ends
+        for (int successor : cfg.blocks[b].successors)
+        {
+            const char *in = live_in.data() + successor * variable_count;
+            for (size_t v = 0; v < variable_count; ++v)
+                live[v] |= in[v];
+        }
+    };
+    for (bool stable = false; !stable;)
+    {
+        stable = true;
+        for (size_t b = cfg.blocks.size(); b-- > 0;)
+        {
+            live_out(b);
+            transfer(live.data(), cfg.blocks[b].begin, cfg.blocks[b].end);
+            char *in = live_in.data() + b * variable_count;
+            if (!std::equal(live.begin(), live.end(), in))
+            {
+                std::copy(live.begin(), live.end(), in);
+                stable = false;
+            }
+        }
+    }
+
+    std::vector<bool> removed(rpn.size(), false);
+    bool changed = false;
+    for (size_t b = 0; b < cfg.blocks.size(); ++b)
+    {
+        live_out(b);
+        for (size_t pc = cfg.blocks[b].end; pc-- > cfg.blocks[b].begin;)
+        {
+            if (store_begin[pc] != kNone && !live[store_slot[pc]])
+            {
+                for (size_t i = store_begin[pc]; i <= pc; ++i)
+                    removed[i] = true;
+                report.dead_stores++;
+                changed = true;
+                pc = store_begin[pc]; // The right-hand side goes too, so its reads do not count
+                continue;
+            }
+            transfer(live.data(), pc, pc + 1);
+        }
+    }
+    compact_rpn(rpn, removed);
+    return changed;
+}
+
+// Удаление мёртвого кода по графу потока управления. Переход по константе (то, во что fold_constants
+// превращает if (1 ~ 0)) либо исчезает, либо становится безусловным; блоки, до которых нет пути от начала
+// программы, и переходы на следующую запись удаляются. Затем анализ живых переменных убирает присваивания
+// x = E;, значение которых больше нигде не читается, если E не может завершиться ошибкой.
+// Каждый шаг может открыть работу для другого, поэтому всё повторяется до неподвижной точки.
+RPNDeadCodeReport eliminate_dead_code(std::vector<RPNEntry> &rpn)
+{
+    RPNDeadCodeReport report;
+    report.entries_before = rpn.size();
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        const std::vector<bool> is_target = rpn_jump_targets(rpn);
+        std::vector<bool> removed(rpn.size(), false);
+        for (size_t pc = 0; pc + 1 < rpn.size(); ++pc)
+        {
+            if (rpn[pc].opcode != RPNOpcode::PUSH_CONST || rpn[pc + 1].opcode != RPNOpcode::JUMP_FALSE || is_target[pc + 1])
+                continue;
+            removed[pc] = true;
+            if (rpn[pc].operand != 0)
+                removed[pc + 1] = true; // Never taken
+            else
+                rpn[pc + 1] = RPNEntry(RPNItemType::JUMP, RPNOpcode::JUMP, "", rpn[pc + 1].line_num, rpn[pc + 1].operand);
+            report.folded_branches++;
+            changed = true;
+            ++pc;
+        }
+        compact_rpn(rpn, removed);
+        if (eliminate_dead_blocks(rpn, report))
+            changed = true;
+        if (eliminate_dead_stores(rpn, report))
+            changed = true;
+    }
+    report.entries_after = rpn.size();
+    return report;
+}
+
+// Interval of int values; long long, so bound arithmetic itself cannot overflow
+struct ValueRange
+{
+    long long lo;
+    long long hi;
+
+    static ValueRange full() { return {std::numeric_limits<int>::min(), std::numeric_limits<int>::max()}; }
+    static ValueRange constant(long long value) { return {value, value}; }
+    bool empty() const { return lo > hi; }
+    bool operator==(const ValueRange &other) const { return lo == other.lo && hi == other.hi; }
+    bool operator!=(const ValueRange &other) const { return !(*this == other); }
+};
+
+// Bounds outside int mean the operation may wrap: anything is possible then
+ValueRange range_or_full(long long lo, long long hi)
+{
+    if (lo < std::numeric_limits<int>::min() || hi > std::numeric_limits<int>::max())
+        return ValueRange::full();
+    return {lo, hi};
+}
+
+ValueRange range_arithmetic(RPNOpcode op, ValueRange a, ValueRange b)
+{
+    if (a.empty() || b.empty())
+        return {1, 0}; // No value reaches the operation
+    switch (op)
+    {
+    case RPNOpcode::ADD:
+        return range_or_full(a.lo + b.lo, a.hi + b.hi);
+    case RPNOpcode::SUB:
+        return range_or_full(a.lo - b.hi, a.hi - b.lo);
+    case RPNOpcode::MUL:
+    {
+        long long c[] = {a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi};
+        return range_or_full(*std::min_element(c, c + 4), *std::max_element(c, c + 4));
+    }
+    default: // DIV; division by zero and INT_MIN / -1 stop the program, so those quotients never appear
+    {
+        long long lo, hi;
+        if (b.lo > 0 || b.hi < 0)
+        {
+            long long c[] = {a.lo / b.lo, a.lo / b.hi, a.hi / b.lo, a.hi / b.hi};
+            lo = *std::min_element(c, c + 4);
+            hi = *std::max_element(c, c + 4);
+        }
+        else
+        {
+            hi = std::max(std::llabs(a.lo), std::llabs(a.hi)); // |a / b| <= |a| for b != 0
+            lo = -hi;
+        }
+        return {std::max<long long>(lo, std::numeric_limits<int>::min()), std::min<long long>(hi, std::numeric_limits<int>::max())};
+    }
+    }
+}
+
+// Narrows a and b to the values for which the comparison has the given outcome; false if there are none
+bool refine_comparison(RPNOpcode op, bool outcome, ValueRange &a, ValueRange &b)
+{
+    if (op == RPNOpcode::CMP_GT || op == RPNOpcode::JUMP_FALSE_GT)
+        return refine_comparison(RPNOpcode::CMP_LT, outcome, b, a); // a > b is b < a
+    if (op == RPNOpcode::CMP_NE || op == RPNOpcode::JUMP_FALSE_NE)
+        return refine_comparison(RPNOpcode::CMP_EQ, !outcome, a, b);
+    if (op == RPNOpcode::CMP_LT || op == RPNOpcode::JUMP_FALSE_LT)
+    {
+        if (outcome)
+        {
+            a.hi = std::min(a.hi, b.hi - 1);
+            b.lo = std::max(b.lo, a.lo + 1);
+        }
+        else
+        {
+            a.lo = std::max(a.lo, b.lo);
+            b.hi = std::min(b.hi, a.hi);
+        }
+    }
+    else if (outcome) // ==
+    {
+        a.lo = b.lo = std::max(a.lo, b.lo);
+        a.hi = b.hi = std::min(a.hi, b.hi);
+    }
+    else // != : only a single excluded value at an end of the other range can be cut off
+    {
+        if (b.lo == b.hi && a.lo == b.lo)
+            a.lo++;
+        if (b.lo == b.hi && a.hi == b.lo)
+            a.hi--;
+        if (a.lo == a.hi && b.lo == a.lo)
+            b.lo++;
+        if (a.lo == a.hi && b.hi == a.lo)
+            b.hi--;
+    }
+    return !a.empty() && !b.empty();
+}
+
+// One array access and what the analysis found out about its index
+struct RPNBoundsAccess
+{
+    int line;
+    std::string array;
+    const char *kind; // "load", "store" or "input"
+    int size;         // Declared size, -1 if the array is not known statically
+    bool reachable = false;
+    ValueRange index{1, 0}; // Hull over every path reaching the access; empty while unreachable
+    bool unchecked = false;
+};
+
+struct RPNBoundsReport
+{
+    int unchecked = 0;
+    int checked = 0;
+    std::vector<RPNBoundsAccess> accesses; // In program order
+};
+
+// Удаление проверок границ. Интервальный анализ по базовым блокам: для каждой переменной известен
+// диапазон значений, условия переходов (i < n, i > 0, ...) сужают его на каждой из двух дуг, а на
+// обратных дугах циклов диапазоны расширяются до границ int, чтобы анализ сошёлся. Доступ, индекс
+// которого на всех путях лежит в [0, size), получает вариант инструкции без проверки.
+// Ввод в элемент массива (cin(a[i])) проверку сохраняет всегда.
+RPNBoundsReport eliminate_bounds_checks(std::vector<RPNEntry> &rpn, const SymbolTable &symbols)
+{
+    RPNBoundsReport report;
+    std::vector<int> array_size;
+    std::vector<std::string> array_name;
+    size_t variable_count = 0;
+    for (const SymbolInfo &info : symbols)
+    {
+        if (!info.is_declared || info.slot < 0)
+            continue;
+        size_t slot = static_cast<size_t>(info.slot);
+        if (info.s_class == SymbolClass::INT_VAR)
+            variable_count = std::max(variable_count, slot + 1);
+        else if (info.s_class == SymbolClass::INT_ARRAY)
+        {
+            if (array_size.size() <= slot)
+            {
+                array_size.resize(slot + 1, -1);
+                array_name.resize(slot + 1);
+            }
+            array_size[slot] = info.size;
+            array_name[slot] = info.name;
+        }
+    }
+
+    // A value on the operand stack. `var` is set while the value still equals that variable, so a branch
+    // on it (or on a comparison of it) narrows the variable itself
+    struct Value
+    {
+        ValueRange range;
+        int var;
+        bool is_compare;
+        RPNOpcode compare;
+        ValueRange lhs, rhs;
+        int lhs_var, rhs_var;
+    };
+    struct State
+    {
+        bool reached = false;
+        std::vector<ValueRange> vars;
+        std::vector<Value> values;
+        std::vector<int> refs; // Variable or array slot, -1 when paths disagree
+    };
+    auto plain = [](ValueRange range, int var = -1)
+    { return Value{range, var, false, RPNOpcode::CMP_EQ, {}, {}, -1, -1}; };
+
+    std::vector<int> access_at(rpn.size(), -1);
+    for (size_t pc = 0; pc < rpn.size(); ++pc)
+    {
+        const RPNEntry &entry = rpn[pc];
+        const char *kind = nullptr;
+        switch (entry.opcode)
+        {
+        case RPNOpcode::ARRAY_LOAD:
+        case RPNOpcode::LOAD_ARRAY_VAR:
+            kind = "load";
+            break;
+        case RPNOpcode::ARRAY_ASSIGN:
+            kind = "store";
+            break;
+        case RPNOpcode::INPUT_ARRAY:
+            kind = "input";
+            break;
+        default:
+            break;
+        }
+        if (kind)
+        {
+            access_at[pc] = static_cast<int>(report.accesses.size());
+            report.accesses.push_back({entry.line_num, "", kind, -1});
+        }
+    }
+
+    const RPNControlFlowGraph cfg = build_rpn_cfg(rpn);
+    if (cfg.blocks.empty())
+        return report;
+    std::vector<State> entry_state(cfg.blocks.size());
+    entry_state[0].reached = true;
+    entry_state[0].vars.assign(variable_count, ValueRange::constant(0)); // Variables start at 0
+
+    auto var_range = [&](const State &s, int slot)
+    { return slot >= 0 && static_cast<size_t>(slot) < s.vars.size() ? s.vars[slot] : ValueRange::full(); };
+    auto set_var = [&](State &s, int slot, ValueRange range)
+    {
+        if (slot >= 0 && static_cast<size_t>(slot) < s.vars.size())
+            s.vars[slot] = range;
+    };
+    // The variable changed: stack values no longer equal it
+    auto assign = [&](State &s, int slot, ValueRange range)
+    {
+        if (slot < 0)
+            std::fill(s.vars.begin(), s.vars.end(), ValueRange::full());
+        else
+            set_var(s, slot, range);
+        for (Value &v : s.values)
+        {
+            if (slot < 0 || v.var == slot)
+                v.var = -1;
+            if (slot < 0 || v.lhs_var == slot)
+                v.lhs_var = -1;
+            if (slot < 0 || v.rhs_var == slot)
+                v.rhs_var = -1;
+        }
+    };
+    // False if the index is out of bounds on every path, so the program stops at this access
+    auto access = [&](State &s, size_t pc, int slot, const Value &index)
+    {
+        RPNBoundsAccess &a = report.accesses[access_at[pc]];
+        bool known = slot >= 0 && static_cast<size_t>(slot) < array_size.size() && array_size[slot] >= 0;
+        a.reachable = true;
+        a.size = known ? array_size[slot] : -1;
+        a.array = known ? array_name[slot] : "?";
+        ValueRange seen = known ? index.range : ValueRange::full();
+        a.index = a.index.empty() ? seen : ValueRange{std::min(a.index.lo, seen.lo), std::max(a.index.hi, seen.hi)};
+        // Past the access the index is in bounds: otherwise the program has already stopped
+        if (!known)
+            return true;
+        ValueRange in_bounds{std::max<long long>(index.range.lo, 0), std::min<long long>(index.range.hi, array_size[slot] - 1)};
+        if (in_bounds.empty())
+            return false;
+        if (index.var >= 0)
+        {
+            ValueRange r = var_range(s, index.var);
+            set_var(s, index.var, {std::max(r.lo, in_bounds.lo), std::min(r.hi, in_bounds.hi)});
+        }
+        return true;
+    };
+    // Narrows the state to the paths where `condition` is true (outcome) or false; false if there are none
+    auto assume = [&](State &s, const Value &condition, bool outcome)
+    {
+        if (condition.is_compare)
+        {
+            ValueRange a = condition.lhs, b = condition.rhs;
+            if (!refine_comparison(condition.compare, outcome, a, b))
+                return false;
+            if (condition.lhs_var >= 0)
+                set_var(s, condition.lhs_var, a);
+            if (condition.rhs_var >= 0)
+                set_var(s, condition.rhs_var, condition.rhs_var == condition.lhs_var ? ValueRange{std::max(a.lo, b.lo), std::min(a.hi, b.hi)} : b);
+            return true;
+        }
+        ValueRange r = condition.range;
+        if (outcome)
+        {
+            if (r.lo == 0 && r.hi == 0)
+                return false;
+            if (r.lo == 0)
+                r.lo = 1;
+            if (r.hi == 0)
+                r.hi = -1;
+        }
+        else
+        {
+            if (r.lo > 0 || r.hi < 0)
+                return false;
+            r = ValueRange::constant(0);
+        }
+        if (condition.var >= 0)
+            set_var(s, condition.var, r);
+        return true;
+    };
+    auto compare_value = [&](RPNOpcode op, const Value &a, const Value &b)
+    {
+        ValueRange ta = a.range, tb = b.range, fa = a.range, fb = b.range;
+        bool can_be_true = refine_comparison(op, true, ta, tb);
+        bool can_be_false = refine_comparison(op, false, fa, fb);
+        return Value{{can_be_false ? 0 : 1, can_be_true ? 1 : 0}, -1, true, op, a.range, b.range, a.var, b.var};
+    };
+
+    // Joins `from` into the entry state of a block; back edges widen every bound that moved
+    std::vector<bool> queued(cfg.blocks.size(), false);
+    std::vector<int> worklist{0};
+    queued[0] = true;
+    auto propagate = [&](int target, const State &from, bool widen)
+    {
+        State &into = entry_state[target];
+        bool changed = false;
+        if (!into.reached)
+        {
+            into = from;
+            for (Value &v : into.values)
+                v = plain(v.range);
+            changed = true;
+        }
+        else
+        {
+            if (into.values.size() != from.values.size() || into.refs.size() != from.refs.size())
+                throw std::runtime_error("Optimizer Error: Inconsistent stack depth at RPN PC " + std::to_string(cfg.blocks[target].begin) + ".");
+            auto join = [&](ValueRange &old_range, const ValueRange &range)
+            {
+                ValueRange joined{std::min(old_range.lo, range.lo), std::max(old_range.hi, range.hi)};
+                if (widen && joined.lo < old_range.lo)
+                    joined.lo = std::numeric_limits<int>::min();
+                if (widen && joined.hi > old_range.hi)
+                    joined.hi = std::numeric_limits<int>::max();
+                if (joined != old_range)
+                {
+                    old_range = joined;
+                    changed = true;
+                }
+            };
+            for (size_t i = 0; i < into.vars.size(); ++i)
+                join(into.vars[i], from.vars[i]);
+            for (size_t i = 0; i < into.values.size(); ++i)
+                join(into.values[i].range, from.values[i].range);
+            for (size_t i = 0; i < into.refs.size(); ++i)
+            {
+                if (into.refs[i] != from.refs[i] && into.refs[i] != -1)
+                {
+                    into.refs[i] = -1;
+                    changed = true;
+                }
+            }
+        }
+        if (changed && !queued[target])
+        {
+            queued[target] = true;
+            worklist.push_back(target);
+            std::push_heap(worklist.begin(), worklist.end(), std::greater<int>());
+        }
+    };
+
+    while (!worklist.empty())
+    {
+        std::pop_heap(worklist.begin(), worklist.end(), std::greater<int>()); // Lowest block first
+        const int b = worklist.back();
+        worklist.pop_back();
+        queued[b] = false;
+        const RPNBasicBlock &block = cfg.blocks[b];
+        State s = entry_state[b];
+
+        auto pop = [&]()
+        {
+            if (s.values.empty())
+                throw std::runtime_error("Optimizer Error: Operand stack underflow in bounds analysis.");
+            Value v = s.values.back();
+            s.values.pop_back();
+            return v;
+        };
+        auto pop_ref = [&]()
+        {
+            if (s.refs.empty())
+                throw std::runtime_error("Optimizer Error: Reference stack underflow in bounds analysis.");
+            int slot = s.refs.back();
+            s.refs.pop_back();
+            return slot;
+        };
+        auto edge = [&](size_t target_pc, const State &state)
+        {
+            int target = cfg.block_at[target_pc];
+            if (target >= 0)
+                propagate(target, state, target <= b);
+        };
+
+        for (size_t pc = block.begin; pc < block.end && s.reached; ++pc) // Stops where the program is known to stop
+        {
+            const RPNEntry &entry = rpn[pc];
+            switch (entry.opcode)
+            {
+            case RPNOpcode::LOAD_VAR:
+                s.values.push_back(plain(var_range(s, entry.operand), entry.operand));
+                break;
+            case RPNOpcode::PUSH_CONST:
+                s.values.push_back(plain(ValueRange::constant(entry.operand)));
+                break;
+            case RPNOpcode::PUSH_VAR_REF:
+            case RPNOpcode::PUSH_ARRAY:
+                s.refs.push_back(entry.operand);
+                break;
+            case RPNOpcode::ADD:
+            case RPNOpcode::SUB:
+            case RPNOpcode::MUL:
+            case RPNOpcode::DIV:
+            {
+                Value rhs = pop();
+                Value lhs = pop();
+                s.values.push_back(plain(range_arithmetic(entry.opcode, lhs.range, rhs.range)));
+                break;
+            }
+            case RPNOpcode::CMP_EQ:
+            case RPNOpcode::CMP_GT:
+            case RPNOpcode::CMP_LT:
+            case RPNOpcode::CMP_NE:
+            {
+                Value rhs = pop();
+                Value lhs = pop();
+                s.values.push_back(compare_value(entry.opcode, lhs, rhs));
+                break;
+            }
+            case RPNOpcode::NEG:
+            {
+                ValueRange r = pop().range;
+                s.values.push_back(plain(range_or_full(-r.hi, -r.lo)));
+                break;
+            }
+            case RPNOpcode::ASSIGN:
+            {
+                ValueRange r = pop().range;
+                assign(s, pop_ref(), r);
+                break;
+            }
+            case RPNOpcode::ARRAY_ASSIGN:
+            case RPNOpcode::ARRAY_ASSIGN_UNCHECKED:
+            {
+                pop();
+                Value index = pop();
+                int slot = pop_ref();
+                if (access_at[pc] >= 0 && !access(s, pc, slot, index))
+                    s.reached = false;
+                break;
+            }
+            case RPNOpcode::ARRAY_LOAD:
+            case RPNOpcode::ARRAY_LOAD_UNCHECKED:
+            case RPNOpcode::INPUT_ARRAY:
+            {
+                Value index = pop();
+                int slot = pop_ref();
+                if (access_at[pc] >= 0 && !access(s, pc, slot, index))
+                    s.reached = false;
+                if (entry.opcode != RPNOpcode::INPUT_ARRAY)
+                    s.values.push_back(plain(ValueRange::full()));
+                break;
+            }
+            case RPNOpcode::LOAD_ARRAY_VAR:
+            case RPNOpcode::LOAD_ARRAY_VAR_UNCHECKED:
+                if (access_at[pc] >= 0 && !access(s, pc, entry.operand, plain(var_range(s, entry.operand2), entry.operand2)))
+                    s.reached = false;
+                s.values.push_back(plain(ValueRange::full()));
+                break;
+            case RPNOpcode::LOAD_ADD_CONST:
+                s.values.push_back(plain(range_arithmetic(RPNOpcode::ADD, var_range(s, entry.operand), ValueRange::constant(entry.operand2))));
+                break;
+            case RPNOpcode::INPUT:
+                assign(s, pop_ref(), ValueRange::full());
+                break;
+            case RPNOpcode::OUTPUT:
+                pop();
+                break;
+            case RPNOpcode::SIN:
+            case RPNOpcode::COS:
+            case RPNOpcode::TG:
+            case RPNOpcode::CTG:
+                pop();
+                s.values.push_back(plain(ValueRange::full()));
+                break;
+            case RPNOpcode::JUMP:
+                edge(static_cast<size_t>(entry.operand), s);
+                break;
+            case RPNOpcode::JUMP_FALSE:
+            case RPNOpcode::JUMP_FALSE_EQ:
+            case RPNOpcode::JUMP_FALSE_GT:
+            case RPNOpcode::JUMP_FALSE_LT:
+            case RPNOpcode::JUMP_FALSE_NE:
+            {
+                Value condition = pop();
+                if (entry.opcode != RPNOpcode::JUMP_FALSE)
+                    condition = compare_value(entry.opcode, pop(), condition);
+                State taken = s;
+                if (assume(taken, condition, false))
+                    edge(static_cast<size_t>(entry.operand), taken);
+                if (!assume(s, condition, true))
+                    s.reached = false; // The fall-through edge is never taken
+                break;
+            }
+            }
+        }
+        if (s.reached && rpn[block.end - 1].opcode != RPNOpcode::JUMP)
+            edge(block.end, s);
+    }
+
+    for (size_t pc = 0; pc < rpn.size(); ++pc)
+    {
+        if (access_at[pc] < 0)
+            continue;
+        RPNBoundsAccess &a = report.accesses[access_at[pc]];
+        a.unchecked = a.reachable && a.size >= 0 && std::strcmp(a.kind, "input") != 0 && a.index.lo >= 0 && a.index.hi < a.size;
+        if (!a.unchecked)
+        {
+            report.checked++;
+            continue;
+        }
+        report.unchecked++;
+        RPNEntry &entry = rpn[pc];
+        entry.opcode = entry.opcode == RPNOpcode::ARRAY_LOAD       ? RPNOpcode::ARRAY_LOAD_UNCHECKED
+                       : entry.opcode == RPNOpcode::ARRAY_ASSIGN ? RPNOpcode::ARRAY_ASSIGN_UNCHECKED
+                                                                 : RPNOpcode::LOAD_ARRAY_VAR_UNCHECKED;
+    }
+    return report;
+}
+
+std::string range_to_string(const ValueRange &range)
+{
+    auto bound = [](long long v)
+    {
+        if (v <= std::numeric_limits<int>::min())
+            return std::string("-inf");
+        if (v >= std::numeric_limits<int>::max())
+            return std::string("+inf");
+        return std::to_string(v);
+    };
+    return "[" + bound(range.lo) + ", " + bound(range.hi) + "]";
+}
+
+// Why each access kept or lost its check
+void print_bounds_report(std::ostream &out, const RPNBoundsReport &report)
+{
+    out << "--- Проверки границ массивов ---\n";
+    out << "  unchecked: " << report.unchecked << ", checked: " << report.checked << "\n";
+    for (const RPNBoundsAccess &a : report.accesses)
+    {
+        out << "  line " << a.line << ": " << a.array << "[] " << a.kind << " - " << (a.unchecked ? "unchecked" : "checked") << ": ";
+        if (!a.reachable)
+            out << "never executed";
+        else if (a.size < 0)
+            out << "array not known statically";
+        else if (a.unchecked)
+            out << "index " << range_to_string(a.index) << " within size " << a.size;
+        else if (std::strcmp(a.kind, "input") == 0)
+            out << "input into an array is always checked";
+        else if (a.index.lo < 0)
+            out << "index " << range_to_string(a.index) << " may be negative";
+        else
+            out << "index " << range_to_string(a.index) << " may reach size " << a.size;
+        out << "\n";
+    }
+    out << "--- Конец отчёта ---\n"
+        << std::endl;
+}
+
+struct RPNFusionReport
+{
+    size_t entries_before = 0;
+    size_t entries_after = 0;
+    int load_add_const = 0;      // VAR x, CONST k, +/-
+    int compare_and_branch = 0;  // ~ > < ! followed by JUMP_FALSE
+    int indexed_load_by_var = 0; // ARRAY_BASE a, VAR i, []
+};
+
+// Peephole pass: merges frequent RPN sequences into superinstructions to cut the number of dispatches.
+// Only the first entry of a sequence may be a jump target.
+RPNFusionReport fuse_superinstructions(std::vector<RPNEntry> &rpn)
+{
+    RPNFusionReport report;
+    report.entries_before = rpn.size();
+    std::vector<bool> is_target = rpn_jump_targets(rpn);
+    std::vector<bool> removed(rpn.size(), false);
+
+    for (size_t i = 0; i < rpn.size(); ++i)
+    {
+        RPNEntry &entry = rpn[i];
+        bool has_two_more = i + 2 < rpn.size() && !is_target[i + 1] && !is_target[i + 2];
+
+        if (has_two_more && entry.opcode == RPNOpcode::LOAD_VAR && rpn[i + 1].opcode == RPNOpcode::PUSH_CONST &&
+            (rpn[i + 2].opcode == RPNOpcode::ADD ||
+             (rpn[i + 2].opcode == RPNOpcode::SUB && rpn[i + 1].operand != std::numeric_limits<int>::min())))
+        {
+            int k = rpn[i + 2].opcode == RPNOpcode::ADD ? rpn[i + 1].operand : -rpn[i + 1].operand;
+            entry = RPNEntry(RPNItemType::SUPERINSTRUCTION, RPNOpcode::LOAD_ADD_CONST, entry.value + rpn[i + 2].value + rpn[i + 1].value,
+                             entry.line_num, entry.operand, k);
+            removed[i + 1] = removed[i + 2] = true;
+            report.load_add_const++;
+            i += 2;
+        }
+        else if (has_two_more && entry.opcode == RPNOpcode::PUSH_ARRAY && rpn[i + 1].opcode == RPNOpcode::LOAD_VAR &&
+                 (rpn[i + 2].opcode == RPNOpcode::ARRAY_LOAD || rpn[i + 2].opcode == RPNOpcode::ARRAY_LOAD_UNCHECKED))
+        {
+            RPNOpcode fused = rpn[i + 2].opcode == RPNOpcode::ARRAY_LOAD ? RPNOpcode::LOAD_ARRAY_VAR : RPNOpcode::LOAD_ARRAY_VAR_UNCHECKED;
+            entry = RPNEntry(RPNItemType::SUPERINSTRUCTION, fused, entry.value + "[" + rpn[i + 1].value + "]",
+                             rpn[i + 2].line_num, entry.operand, rpn[i + 1].operand);
+            removed[i + 1] = removed[i + 2] = true;
+            report.indexed_load_by_var++;
+            i += 2;
+        }
+        else if (i + 1 < rpn.size() && !is_target[i + 1] && rpn[i + 1].opcode == RPNOpcode::JUMP_FALSE)
+        {
+            RPNOpcode fused;
+            switch (entry.opcode)
+            {
+            case RPNOpcode::CMP_EQ:
+                fused = RPNOpcode::JUMP_FALSE_EQ;
+                break;
+            case RPNOpcode::CMP_GT:
+                fused = RPNOpcode::JUMP_FALSE_GT;
+                break;
+            case RPNOpcode::CMP_LT:
+                fused = RPNOpcode::JUMP_FALSE_LT;
+                break;
+            case RPNOpcode::CMP_NE:
+                fused = RPNOpcode::JUMP_FALSE_NE;
+                break;
+            default:
+                continue;
+            }
+            entry = RPNEntry(RPNItemType::SUPERINSTRUCTION, fused, entry.value, rpn[i + 1].line_num, rpn[i + 1].operand);
+            removed[i + 1] = true;
+            report.compare_and_branch++;
+            i += 1;
+        }
+    }
+
+    compact_rpn(rpn, removed);
+    report.entries_after = rpn.size();
+    return report;
+}
+
+// --- Профилировщик ОПЗ (RPNInterpreter::run_profiled) ---
+
+// Часы профилировщика: счётчик тактов на x86-64, иначе наносекунды steady_clock
+#if defined(__x86_64__) || defined(_M_X64)
+inline uint64_t profile_clock() { return __rdtsc(); }
+constexpr const char *kProfileClockUnit = "cycles";
+#else
+inline uint64_t profile_clock()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+constexpr const char *kProfileClockUnit = "ns";
+#endif
+
+// Per-PC counters filled by run_profiled(); per-opcode and per-line totals are summed from them for reports.
+// Time of an instruction is the clock delta to the start of the next one, so it includes dispatch.
+struct RPNProfile
+{
+    std::vector<uint64_t> counts; // counts[pc] = times m_rpn[pc] was executed
+    std::vector<uint64_t> ticks;  // ticks[pc] = profile_clock() units spent in m_rpn[pc]
+
+    void reset(size_t code_size)
+    {
+        counts.assign(code_size, 0);
+        ticks.assign(code_size, 0);
+    }
+};
+
+struct RPNProfileRow
+{
+    std::string label; // "PC 12", opcode name or "line 7"
+    uint64_t count = 0;
+    uint64_t ticks = 0;
+    int pc = -1;   // PC rows only
+    int line = 0;  // PC and line rows
+};
+
+struct RPNProfileSummary
+{
+    uint64_t total_count = 0;
+    uint64_t total_ticks = 0;
+    std::vector<RPNProfileRow> pcs, opcodes, lines; // Executed rows only, hottest first
+};
+
+RPNProfileSummary summarize_profile(const RPNProfile &profile, const std::vector<RPNEntry> &rpn)
+{
+    RPNProfileSummary summary;
+    RPNProfileRow by_opcode[kRPNOpcodeCount];
+    std::vector<RPNProfileRow> by_line;
+    for (size_t pc = 0; pc < rpn.size() && pc < profile.counts.size(); ++pc)
+    {
+        if (profile.counts[pc] == 0)
+            continue;
+        const RPNEntry &entry = rpn[pc];
+        uint64_t count = profile.counts[pc], ticks = profile.ticks[pc];
+        summary.total_count += count;
+        summary.total_ticks += ticks;
+
+        RPNProfileRow row;
+        row.label = entry.typeToString() + " \"" + entry.displayValue() + "\"";
+        row.count = count;
+        row.ticks = ticks;
+        row.pc = static_cast<int>(pc);
+        row.line = entry.line_num;
+        summary.pcs.push_back(row);
+
+        RPNProfileRow &op_row = by_opcode[static_cast<size_t>(entry.opcode)];
+        op_row.label = rpn_opcode_name(entry.opcode);
+        op_row.count += count;
+        op_row.ticks += ticks;
+
+        size_t line = static_cast<size_t>(std::max(entry.line_num, 0));
+        if (by_line.size() <= line)
+            by_line.resize(line + 1);
+        RPNProfileRow &line_row = by_line[line];
+        line_row.label = "line " + std::to_string(entry.line_num);
+        line_row.line = entry.line_num;
+        line_row.count += count;
+        line_row.ticks += ticks;
+    }
+    for (const RPNProfileRow &row : by_opcode)
+        if (row.count != 0)
+            summary.opcodes.push_back(row);
+    for (const RPNProfileRow &row : by_line)
+        if (row.count != 0)
+            summary.lines.push_back(row);
+    auto hottest_first = [](const RPNProfileRow &a, const RPNProfileRow &b)
+    { return a.ticks != b.ticks ? a.ticks > b.ticks : a.count > b.count; };
+    std::stable_sort(summary.pcs.begin(), summary.pcs.end(), hottest_first);
+    std::stable_sort(summary.opcodes.begin(), summary.opcodes.end(), hottest_first);
+    std::stable_sort(summary.lines.begin(), summary.lines.end(), hottest_first);
+    return summary;
+}
+
+void print_profile_report(std::ostream &out, const RPNProfile &profile, const std::vector<RPNEntry> &rpn)
+{
+    const size_t kTopRows = 20;
+    RPNProfileSummary summary = summarize_profile(profile, rpn);
+    auto percent = [&summary](uint64_t ticks)
+    {
+        std::ostringstream text;
+        text.setf(std::ios::fixed);
+        text.precision(1);
+        text << (summary.total_ticks ? 100.0 * static_cast<double>(ticks) / static_cast<double>(summary.total_ticks) : 0.0) << "%";
+        return text.str();
+    };
+    auto print_rows = [&](const char *title, const std::vector<RPNProfileRow> &rows, size_t limit)
+    {
+        out << "  " << title << ":\n";
+        for (size_t i = 0; i < rows.size() && i < limit; ++i)
+        {
+            const RPNProfileRow &row = rows[i];
+            out << "    ";
+            if (row.pc >= 0)
+                out << "PC " << row.pc << " (Line " << row.line << ") ";
+            out << row.label << ": count " << row.count << ", " << row.ticks << " " << kProfileClockUnit
+                << " (" << percent(row.ticks) << ")\n";
+        }
+        if (rows.size() > limit)
+            out << "    ... " << rows.size() - limit << " more\n";
+    };
+
+    out << "--- Профиль выполнения ---\n";
+    out << "  instructions executed: " << summary.total_count << "\n";
+    out << "  total time: " << summary.total_ticks << " " << kProfileClockUnit << "\n";
+    print_rows("hot RPN entries", summary.pcs, kTopRows);
+    print_rows("by opcode", summary.opcodes, summary.opcodes.size());
+    print_rows("by source line", summary.lines, kTopRows);
+    out << "--- Конец профиля ---" << std::endl;
+}
+
+std::string json_escape(const std::string &text)
+{
+    std::string escaped;
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char code[8];
+            std::snprintf(code, sizeof code, "\\u%04x", static_cast<unsigned>(c));
+            escaped += code;
+            continue;
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+// Все исполнявшиеся строки, без обрезки до kTopRows
+void write_profile_json(std::ostream &out, const RPNProfile &profile, const std::vector<RPNEntry> &rpn)
+{
+    RPNProfileSummary summary = summarize_profile(profile, rpn);
+    auto write_rows = [&out](const char *name, const std::vector<RPNProfileRow> &rows, bool last)
+    {
+        out << "  \"" << name << "\": [";
+        for (size_t i = 0; i < rows.size(); ++i)
+        {
+            const RPNProfileRow &row = rows[i];
+            out << (i ? ",\n    " : "\n    ") << "{";
+            if (row.pc >= 0)
+                out << "\"pc\": " << row.pc << ", ";
+            if (row.line > 0)
+                out << "\"line\": " << row.line << ", ";
+            out << "\"label\": \"" << json_escape(row.label) << "\", \"count\": " << row.count << ", \"ticks\": " << row.ticks << "}";
+        }
+        out << (rows.empty() ? "]" : "\n  ]") << (last ? "\n" : ",\n");
+    };
+    out << "{\n";
+    out << "  \"unit\": \"" << kProfileClockUnit << "\",\n";
+    out << "  \"instructions_executed\": " << summary.total_count << ",\n";
+    out << "  \"total_ticks\": " << summary.total_ticks << ",\n";
+    write_rows("pcs", summary.pcs, false);
+    write_rows("opcodes", summary.opcodes, false);
+    write_rows("lines", summary.lines, true);
+    out << "}\n";
+}
+
+// --- Куча массивов (общая для механизмов выполнения) ---
+//
+// Все объявленные массивы лежат в одном непрерывном блоке, выровненном по строке кэша. Смещение и длина
+// каждого массива считаются один раз при подготовке: проверка границ - одно беззнаковое сравнение с
+// длиной из плотной таблицы, без отдельного std::vector на массив.
+
+struct ArrayExtent
+{
+    int offset; // In ints from the start of the heap, a multiple of ArrayHeap::kAlignmentInts
+    int length; // SymbolInfo::size
+};
+
+class ArrayHeap
+{
+public:
+    static constexpr size_t kAlignment = 64; // Cache line
+    static constexpr int kAlignmentInts = static_cast<int>(kAlignment / sizeof(int));
+
+    ArrayHeap() = default;
+    ArrayHeap(const ArrayHeap &) = delete;
+    ArrayHeap &operator=(const ArrayHeap &) = delete;
+    ~ArrayHeap() { release(); }
+
+    // sizes[slot] and names[slot] describe the array with that slot; one zero-filled allocation for all of them
+    void build(const std::vector<int> &sizes, std::vector<std::string> names)
+    {
+        release();
+        m_extents.clear();
+        m_extents.reserve(sizes.size());
+        size_t total = 0;
+        for (int length : sizes)
+        {
+            total = (total + kAlignmentInts - 1) / kAlignmentInts * kAlignmentInts;
+            if (total > static_cast<size_t>(std::numeric_limits<int>::max()) - static_cast<size_t>(length))
+                throw std::runtime_error("Interpreter Setup Error: Arrays do not fit into the array heap.");
+            m_extents.push_back({static_cast<int>(total), length});
+            total += static_cast<size_t>(length);
+        }
+        m_names = std::move(names);
+        m_size = total;
+        if (m_size == 0)
+            return;
+        m_data = static_cast<int *>(::operator new(m_size * sizeof(int), std::align_val_t(kAlignment)));
+        std::memset(m_data, 0, m_size * sizeof(int));
+    }
+
+    // Arrays of the symbol table, slots are dense (assigned by RPNGenerator)
+    void build(const SymbolTable &symbols)
+    {
+        std::vector<int> sizes;
+        std::vector<std::string> names;
+        for (const SymbolInfo &info : symbols)
+        {
+            if (!info.is_declared || info.slot < 0 || info.s_class != SymbolClass::INT_ARRAY)
+                continue;
+            size_t slot = static_cast<size_t>(info.slot);
+            if (sizes.size() <= slot)
+            {
+                sizes.resize(slot + 1, 0);
+                names.resize(slot + 1);
+            }
+            sizes[slot] = info.size;
+            names[slot] = info.name;
+        }
+        build(sizes, std::move(names));
+    }
+
+    size_t count() const { return m_extents.size(); }
+    const ArrayExtent &extent(int slot) const { return m_extents[slot]; }
+    const ArrayExtent *extents() const { return m_extents.data(); }
+    const std::string &name(int slot) const { return m_names[slot]; }
+    int *data() { return m_data; }
+
+    std::string index_error_message(int index, int slot, bool for_input) const
+    {
+        return "Array index " + std::to_string(index) + " out of bounds for " + (for_input ? "input to " : "") + "array '" + m_names[slot] +
+               "' (size " + std::to_string(m_extents[slot].length) + ").";
+    }
+    [[noreturn]] void throw_index_error(int index, int slot, bool for_input) const
+    {
+        throw std::runtime_error(index_error_message(index, slot, for_input));
+    }
+
+    // Element of the array in slot; the index must already be proven in bounds
+    int &element(int slot, int index) { return m_data[m_extents[slot].offset + index]; }
+
+    // Bounds-checked element of the array in slot
+    int &at(int slot, int index, bool for_input = false)
+    {
+        const ArrayExtent &array = m_extents[slot];
+        if (static_cast<unsigned>(index) >= static_cast<unsigned>(array.length))
+            throw_index_error(index, slot, for_input);
+        return m_data[array.offset + index];
+    }
+
+private:
+    int *m_data = nullptr;
+    size_t m_size = 0; // Ints, including alignment padding
+    std::vector<ArrayExtent> m_extents;
+    std::vector<std::string> m_names;
+
+    void release()
+    {
+        if (m_data)
+            ::operator delete(m_data, std::align_val_t(kAlignment));
+        m_data = nullptr;
+        m_size = 0;
+    }
+};
+
+// RPN Interpreter Class
+class RPNInterpreter
+{
+public:
+    RPNInterpreter(const std::vector<RPNEntry> &rpn, const SymbolTable &symbolTable)
+        : m_rpn(rpn), m_symbolTable(symbolTable), m_pc(0), m_valueTop(0), m_refTop(0)
+    {
+        // Pre-populate variables from symbol table (slots are dense, assigned by RPNGenerator); arrays share one heap
+        m_arrays.build(m_symbolTable);
+        for (const SymbolInfo &info : m_symbolTable)
+        {
+            const std::string &name = info.name;
+            if (!info.is_declared || info.slot < 0)
+                continue;
+            size_t slot = static_cast<size_t>(info.slot);
+            if (info.s_class == SymbolClass::INT_VAR)
+            {
+                if (m_variables.size() <= slot)
+                {
+                    m_variables.resize(slot + 1, 0); // Default initialize to 0
+                    m_variableNames.resize(slot + 1);
+                }
+                m_variableNames[slot] = name;
+            }
+        }
+        // Every slot and jump target referenced by the program must be valid
+        auto check_var_slot = [this](int slot, const RPNEntry &entry)
+        {
+            if (slot < 0 || static_cast<size_t>(slot) >= m_variables.size())
+                throw std::runtime_error("Interpreter Setup Error: Invalid variable slot " + std::to_string(slot) + " for '" + entry.value + "'.");
+        };
+        auto check_array_slot = [this](int slot, const RPNEntry &entry)
+        {
+            if (slot < 0 || static_cast<size_t>(slot) >= m_arrays.count())
+                throw std::runtime_error("Interpreter Setup Error: Invalid array slot " + std::to_string(slot) + " for '" + entry.value + "'.");
+        };
+        for (const RPNEntry &entry : m_rpn)
+        {
+            switch (entry.opcode)
+            {
+            case RPNOpcode::LOAD_VAR:
+            case RPNOpcode::PUSH_VAR_REF:
+            case RPNOpcode::LOAD_ADD_CONST:
+                check_var_slot(entry.operand, entry);
+                break;
+            case RPNOpcode::PUSH_ARRAY:
+                check_array_slot(entry.operand, entry);
+                break;
+            case RPNOpcode::LOAD_ARRAY_VAR:
+            case RPNOpcode::LOAD_ARRAY_VAR_UNCHECKED:
+                check_array_slot(entry.operand, entry);
+                check_var_slot(entry.operand2, entry);
+                break;
+            default:
+                // Jump targets are absolute RPN indices; m_rpn.size() means "fall off the end"
+                if (rpn_is_jump(entry.opcode) && (entry.operand < 0 || static_cast<size_t>(entry.operand) > m_rpn.size()))
+                {
+                    throw std::runtime_error("Interpreter Setup Error: Jump from source line " + std::to_string(entry.line_num) +
+                                             " has invalid target " + std::to_string(entry.operand) + ".");
+                }
+                break;
+            }
+        }
+        // The stack layout is checked once here (no underflow, consistent depth at jumps),
+        // so the stacks are sized ahead of time and run() does no bounds checks or reallocation
+        RPNStackLayout layout = compute_stack_layout(m_rpn);
+        m_valueStack.assign(layout.max_value_depth, 0);
+        m_refStack.assign(layout.max_ref_depth, 0);
+        m_threadedCode.assign(m_rpn.size() + 1, nullptr); // Filled on the first run_threaded()
+    }
+
+    void run() { run_loop<false>(nullptr); }
+
+    // Тот же цикл со счётчиками и временем на каждую запись ОПЗ
+    void run_profiled(RPNProfile &profile)
+    {
+        profile.reset(m_rpn.size());
+        run_loop<true>(&profile);
+    }
+
+private:
+    // Profile = false compiles every profiling statement out, so run() is the plain loop
+    template <bool Profile>
+    void run_loop(RPNProfile *profile)
+    {
+        m_pc = 0;
+        m_valueTop = 0;
+        m_refTop = 0;
+        size_t profiled_pc = 0;
+        uint64_t profiled_since = 0;
+        if constexpr (Profile)
+            profiled_since = profile_clock();
+
+        while (m_pc < m_rpn.size())
+        {
+            const RPNEntry &entry = m_rpn[m_pc];
+            if constexpr (Profile)
+            {
+                uint64_t now = profile_clock();
+                profile->ticks[profiled_pc] += now - profiled_since; // The first delta is the loop set-up, charged to PC 0
+                profiled_since = now;
+                profiled_pc = m_pc;
+                ++profile->counts[m_pc];
+            }
+            // For debugging:
+            // std::cout << "Executing PC " << m_pc << ": " << entry.typeToString() << " \"" << entry.value
+            //           << "\" (Line: " << entry.line_num << ")" << std::endl;
+
+            bool increment_pc = true;
+
+            try
+            {
+                switch (entry.opcode)
+                {
+                case RPNOpcode::LOAD_VAR:
+                    // VAR RPN item means "push the value stored in variable slot".
+                    push_value(m_variables[entry.operand]);
+                    break;
+
+                case RPNOpcode::PUSH_VAR_REF:
+                    // VAR_REF pushes a reference to the slot; '=' and cin use it as a target.
+                    push_ref(entry.operand);
+                    break;
+
+                case RPNOpcode::PUSH_ARRAY:
+                    // ARRAY_BASE RPN item means "push array slot" onto the reference stack.
+                    push_ref(entry.operand);
+                    break;
+
+                case RPNOpcode::PUSH_CONST:
+                    // Decoded by RPNGenerator, no parsing at run time
+                    push_value(entry.operand);
+                    break;
+
+                case RPNOpcode::ADD:
+                {
+                    int b = pop_value();
+                    int a = pop_value();
+                    push_value(wrapping_add(a, b));
+                    break;
+                }
+                case RPNOpcode::SUB:
+                {
+                    int b = pop_value();
+                    int a = pop_value();
+                    push_value(wrapping_sub(a, b));
+                    break;
+                }
+                case RPNOpcode::MUL:
+                {
+                    int b = pop_value();
+                    int a = pop_value();
+                    push_value(wrapping_mul(a, b));
+                    break;
+                }
+                case RPNOpcode::DIV:
+                {
+                    int b = pop_value();
+                    int a = pop_value();
+                    if (b == 0)
+                        throw std::runtime_error("Division by zero.");
+                    push_value(a / b);
+                    break;
+                }
+                case RPNOpcode::CMP_EQ:
+                {
+                    int b = pop_value();
+                    int a = pop_value();
+                    push_value(a == b ? 1 : 0); // Return 1 for true, 0 for false
+                    break;
+                }
+                case RPNOpcode::CMP_GT:
+                {
+                    int b = pop_value();
+                    int a = pop_value();
+                    push_value(a > b ? 1 : 0);
+                    break;
+                }
+                case RPNOpcode::CMP_LT:
+                {
+                    int b = pop_value();
+                    int a = pop_value();
+                    push_value(a < b ? 1 : 0);
+                    break;
+                }
+                case RPNOpcode::CMP_NE:
+                {
+                    int b = pop_value();
+                    int a = pop_value();
+                    push_value(a != b ? 1 : 0); // Not equal
+                    break;
+                }
+
+                case RPNOpcode::NEG:
+                    // Обработка унарного минуса
+                    push_value(wrapping_neg(pop_value()));
+                    break;
+
+                case RPNOpcode::ASSIGN:
+                    m_variables[pop_ref()] = pop_value();
+                    break;
+
+                case RPNOpcode::ARRAY_ASSIGN: // "[]="
+                    handle_array_assign();
+                    break;
+
+                case RPNOpcode::ARRAY_LOAD: // "[]"
+                    handle_array_access();
+                    break;
+
+                case RPNOpcode::ARRAY_ASSIGN_UNCHECKED:
+                {
+                    int value = pop_value();
+                    int index = pop_value();
+                    m_arrays.element(pop_ref(), index) = value;
+                    break;
+                }
+
+                case RPNOpcode::ARRAY_LOAD_UNCHECKED:
+                {
+                    int index = pop_value();
+                    push_value(m_arrays.element(pop_ref(), index));
+                    break;
+                }
+
+                case RPNOpcode::JUMP:
+                    m_pc = static_cast<size_t>(entry.operand);
+                    increment_pc = false; // PC is set directly, don't increment at the end
+                    break;
+
+                case RPNOpcode::JUMP_FALSE:
+                    if (pop_value() == 0)
+                    { // If condition is false (0)
+                        m_pc = static_cast<size_t>(entry.operand);
+                        increment_pc = false;
+                    }
+                    break;
+
+                case RPNOpcode::INPUT:
+                case RPNOpcode::INPUT_ARRAY:
+                    handle_input(entry);
+                    break;
+
+                case RPNOpcode::OUTPUT:
+                    handle_output();
+                    break;
+
+                case RPNOpcode::SIN:
+                case RPNOpcode::COS:
+                case RPNOpcode::TG:
+                case RPNOpcode::CTG:
+                    handle_trig_function(entry);
+                    break;
+
+                // Суперинструкции
+                case RPNOpcode::LOAD_ADD_CONST:
+                    push_value(wrapping_add(m_variables[entry.operand], entry.operand2));
+                    break;
+
+                case RPNOpcode::LOAD_ARRAY_VAR:
+                    push_value(m_arrays.at(entry.operand, m_variables[entry.operand2]));
+                    break;
+
+                case RPNOpcode::LOAD_ARRAY_VAR_UNCHECKED:
+                    push_value(m_arrays.element(entry.operand, m_variables[entry.operand2]));
+                    break;
+
+                case RPNOpcode::JUMP_FALSE_EQ:
+                case RPNOpcode::JUMP_FALSE_GT:
+                case RPNOpcode::JUMP_FALSE_LT:
+                case RPNOpcode::JUMP_FALSE_NE:
+                {
+                    int b = pop_value();
+                    int a = pop_value();
+                    bool condition = entry.opcode == RPNOpcode::JUMP_FALSE_EQ   ? a == b
+                                     : entry.opcode == RPNOpcode::JUMP_FALSE_GT ? a > b
+                                     : entry.opcode == RPNOpcode::JUMP_FALSE_LT ? a < b
+                                                                                : a != b;
+                    if (!condition)
+                    {
+                        m_pc = static_cast<size_t>(entry.operand);
+                        increment_pc = false;
+                    }
+                    break;
+                }
+
+                default:
+                    throw std::runtime_error("Unknown RPN opcode " + std::to_string(static_cast<int>(entry.opcode)) + " (" + entry.typeToString() + ").");
+                }
+            }
+            catch (const std::runtime_error &e)
+            {
+                // Augment error with line number from RPN entry
+                throw std::runtime_error("Interpreter Error (Source Line " + std::to_string(entry.line_num) +
+                                         ", RPN PC " + std::to_string(m_pc) + "): " + e.what());
+            }
+
+            if (increment_pc)
+            {
+                m_pc++;
+            }
+            // Debug operand stack:
+            // print_operand_stack_debug();
+        }
+        if constexpr (Profile)
+        {
+            if (!m_rpn.empty())
+                profile->ticks[profiled_pc] += profile_clock() - profiled_since;
+        }
+    }
+
+public:
+
+    // Второй механизм выполнения той же ОПЗ: шитый код (computed goto) на GCC/Clang,
+    // переносимый switch в остальных компиляторах. Обработчики общие для обоих вариантов;
+    // контекст ошибки (строка, PC) добавляется один раз снаружи цикла, а не на каждой инструкции.
+    void run_threaded()
+    {
+        const RPNEntry *code = m_rpn.data();
+        const size_t code_size = m_rpn.size();
+        int *vars = m_variables.data();
+        int *heap = m_arrays.data();
+        const ArrayExtent *extents = m_arrays.extents();
+        int *vsp = m_valueStack.data(); // Next free value slot
+        int *rsp = m_refStack.data();   // Next free reference slot
+        size_t pc = 0;
+
+// Slow-path helpers work on m_valueTop/m_refTop; the fast path keeps stack pointers in locals
+#define RPN_SYNC_OUT()                                                 \
+    do                                                                 \
+    {                                                                  \
+        m_valueTop = static_cast<size_t>(vsp - m_valueStack.data());   \
+        m_refTop = static_cast<size_t>(rsp - m_refStack.data());       \
+    } while (0)
+#define RPN_SYNC_IN()                          \
+    do                                         \
+    {                                          \
+        vsp = m_valueStack.data() + m_valueTop; \
+        rsp = m_refStack.data() + m_refTop;     \
+    } while (0)
+
+        try
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            // Order must match RPNOpcode
+            static void *const handlers[] = {
+                &&op_LOAD_VAR, &&op_PUSH_VAR_REF, &&op_PUSH_ARRAY, &&op_PUSH_CONST,
+                &&op_ADD, &&op_SUB, &&op_MUL, &&op_DIV,
+                &&op_CMP_EQ, &&op_CMP_GT, &&op_CMP_LT, &&op_CMP_NE,
+                &&op_NEG, &&op_ASSIGN, &&op_ARRAY_ASSIGN, &&op_ARRAY_LOAD,
+                &&op_JUMP, &&op_JUMP_FALSE, &&op_INPUT, &&op_INPUT_ARRAY, &&op_OUTPUT,
+                &&op_SIN, &&op_COS, &&op_TG, &&op_CTG,
+                &&op_LOAD_ADD_CONST, &&op_LOAD_ARRAY_VAR,
+                &&op_JUMP_FALSE_EQ, &&op_JUMP_FALSE_GT, &&op_JUMP_FALSE_LT, &&op_JUMP_FALSE_NE,
+                &&op_ARRAY_ASSIGN_UNCHECKED, &&op_ARRAY_LOAD_UNCHECKED, &&op_LOAD_ARRAY_VAR_UNCHECKED};
+            // Direct threading: one handler address per RPN entry, the extra last entry ends the program
+            if (m_threadedCode[code_size] == nullptr)
+            {
+                for (size_t i = 0; i < code_size; ++i)
+                    m_threadedCode[i] = handlers[static_cast<size_t>(code[i].opcode)];
+                m_threadedCode[code_size] = &&op_END;
+            }
+            void *const *thread = m_threadedCode.data();
+#define RPN_DISPATCH() goto *thread[pc]
+#else
+#define RPN_DISPATCH() goto dispatch
+#endif
+#define RPN_NEXT() \
+    do             \
+    {              \
+        ++pc;      \
+        RPN_DISPATCH(); \
+    } while (0)
+
+            RPN_DISPATCH();
+
+#if !(defined(__GNUC__) || defined(__clang__))
+        dispatch:
+            if (pc >= code_size)
+                goto op_END;
+            switch (code[pc].opcode)
+            {
+            case RPNOpcode::LOAD_VAR: goto op_LOAD_VAR;
+            case RPNOpcode::PUSH_VAR_REF: goto op_PUSH_VAR_REF;
+            case RPNOpcode::PUSH_ARRAY: goto op_PUSH_ARRAY;
+            case RPNOpcode::PUSH_CONST: goto op_PUSH_CONST;
+            case RPNOpcode::ADD: goto op_ADD;
+            case RPNOpcode::SUB: goto op_SUB;
+            case RPNOpcode::MUL: goto op_MUL;
+            case RPNOpcode::DIV: goto op_DIV;
+            case RPNOpcode::CMP_EQ: goto op_CMP_EQ;
+            case RPNOpcode::CMP_GT: goto op_CMP_GT;
+            case RPNOpcode::CMP_LT: goto op_CMP_LT;
+            case RPNOpcode::CMP_NE: goto op_CMP_NE;
+            case RPNOpcode::NEG: goto op_NEG;
+            case RPNOpcode::ASSIGN: goto op_ASSIGN;
+            case RPNOpcode::ARRAY_ASSIGN: goto op_ARRAY_ASSIGN;
+            case RPNOpcode::ARRAY_LOAD: goto op_ARRAY_LOAD;
+            case RPNOpcode::JUMP: goto op_JUMP;
+            case RPNOpcode::JUMP_FALSE: goto op_JUMP_FALSE;
+            case RPNOpcode::INPUT: goto op_INPUT;
+            case RPNOpcode::INPUT_ARRAY: goto op_INPUT_ARRAY;
+            case RPNOpcode::OUTPUT: goto op_OUTPUT;
+            case RPNOpcode::SIN: goto op_SIN;
+            case RPNOpcode::COS: goto op_COS;
+            case RPNOpcode::TG: goto op_TG;
+            case RPNOpcode::CTG: goto op_CTG;
+            case RPNOpcode::LOAD_ADD_CONST: goto op_LOAD_ADD_CONST;
+            case RPNOpcode::LOAD_ARRAY_VAR: goto op_LOAD_ARRAY_VAR;
+            case RPNOpcode::JUMP_FALSE_EQ: goto op_JUMP_FALSE_EQ;
+            case RPNOpcode::JUMP_FALSE_GT: goto op_JUMP_FALSE_GT;
+            case RPNOpcode::JUMP_FALSE_LT: goto op_JUMP_FALSE_LT;
+            case RPNOpcode::JUMP_FALSE_NE: goto op_JUMP_FALSE_NE;
+            case RPNOpcode::ARRAY_ASSIGN_UNCHECKED: goto op_ARRAY_ASSIGN_UNCHECKED;
+            case RPNOpcode::ARRAY_LOAD_UNCHECKED: goto op_ARRAY_LOAD_UNCHECKED;
+            case RPNOpcode::LOAD_ARRAY_VAR_UNCHECKED: goto op_LOAD_ARRAY_VAR_UNCHECKED;
+            }
+            throw std::runtime_error("Unknown RPN opcode " + std::to_string(static_cast<int>(code[pc].opcode)) + ".");
+#endif
+
+        op_LOAD_VAR:
+            *vsp++ = vars[code[pc].operand];
+            RPN_NEXT();
+        op_PUSH_VAR_REF:
+        op_PUSH_ARRAY:
+            *rsp++ = code[pc].operand;
+            RPN_NEXT();
+        op_PUSH_CONST:
+            *vsp++ = code[pc].operand;
+            RPN_NEXT();
+        op_ADD:
+            --vsp;
+            vsp[-1] = wrapping_add(vsp[-1], vsp[0]);
+            RPN_NEXT();
+        op_SUB:
+            --vsp;
+            vsp[-1] = wrapping_sub(vsp[-1], vsp[0]);
+            RPN_NEXT();
+        op_MUL:
+            --vsp;
+            vsp[-1] = wrapping_mul(vsp[-1], vsp[0]);
+            RPN_NEXT();
+        op_DIV:
+            --vsp;
+            if (vsp[0] == 0)
+                throw std::runtime_error("Division by zero.");
+            vsp[-1] = vsp[-1] / vsp[0];
+            RPN_NEXT();
+        op_CMP_EQ:
+            --vsp;
+            vsp[-1] = vsp[-1] == vsp[0] ? 1 : 0;
+            RPN_NEXT();
+        op_CMP_GT:
+            --vsp;
+            vsp[-1] = vsp[-1] > vsp[0] ? 1 : 0;
+            RPN_NEXT();
+        op_CMP_LT:
+            --vsp;
+            vsp[-1] = vsp[-1] < vsp[0] ? 1 : 0;
+            RPN_NEXT();
+        op_CMP_NE:
+            --vsp;
+            vsp[-1] = vsp[-1] != vsp[0] ? 1 : 0;
+            RPN_NEXT();
+        op_NEG:
+            vsp[-1] = wrapping_neg(vsp[-1]);
+            RPN_NEXT();
+        op_ASSIGN:
+            vars[*--rsp] = *--vsp;
+            RPN_NEXT();
+        op_ARRAY_ASSIGN:
+        {
+            int value = *--vsp;
+            int index = *--vsp;
+            int slot = *--rsp;
+            const ArrayExtent &array = extents[slot];
+            if (static_cast<unsigned>(index) >= static_cast<unsigned>(array.length))
+                m_arrays.throw_index_error(index, slot, false);
+            heap[array.offset + index] = value;
+            RPN_NEXT();
+        }
+        op_ARRAY_LOAD:
+        {
+            int index = vsp[-1];
+            int slot = *--rsp;
+            const ArrayExtent &array = extents[slot];
+            if (static_cast<unsigned>(index) >= static_cast<unsigned>(array.length))
+                m_arrays.throw_index_error(index, slot, false);
+            vsp[-1] = heap[array.offset + index];
+            RPN_NEXT();
+        }
+        op_JUMP:
+            pc = static_cast<size_t>(code[pc].operand);
+            RPN_DISPATCH();
+        op_JUMP_FALSE:
+            if (*--vsp == 0)
+            {
+                pc = static_cast<size_t>(code[pc].operand);
+                RPN_DISPATCH();
+            }
+            RPN_NEXT();
+        op_INPUT:
+        op_INPUT_ARRAY:
+            RPN_SYNC_OUT();
+            handle_input(code[pc]);
+            RPN_SYNC_IN();
+            RPN_NEXT();
+        op_OUTPUT:
+            RPN_SYNC_OUT();
+            handle_output();
+            RPN_SYNC_IN();
+            RPN_NEXT();
+        op_SIN:
+        op_COS:
+        op_TG:
+        op_CTG:
+            RPN_SYNC_OUT();
+            handle_trig_function(code[pc]);
+            RPN_SYNC_IN();
+            RPN_NEXT();
+        op_LOAD_ADD_CONST:
+            *vsp++ = wrapping_add(vars[code[pc].operand], code[pc].operand2);
+            RPN_NEXT();
+        op_LOAD_ARRAY_VAR:
+        {
+            int index = vars[code[pc].operand2];
+            const ArrayExtent &array = extents[code[pc].operand];
+            if (static_cast<unsigned>(index) >= static_cast<unsigned>(array.length))
+                m_arrays.throw_index_error(index, code[pc].operand, false);
+            *vsp++ = heap[array.offset + index];
+            RPN_NEXT();
+        }
+        op_ARRAY_ASSIGN_UNCHECKED:
+            vsp -= 2;
+            heap[extents[*--rsp].offset + vsp[0]] = vsp[1];
+            RPN_NEXT();
+        op_ARRAY_LOAD_UNCHECKED:
+            vsp[-1] = heap[extents[*--rsp].offset + vsp[-1]];
+            RPN_NEXT();
+        op_LOAD_ARRAY_VAR_UNCHECKED:
+            *vsp++ = heap[extents[code[pc].operand].offset + vars[code[pc].operand2]];
+            RPN_NEXT();
+// Compare the two top values and jump to operand unless the comparison holds
+#define RPN_COMPARE_AND_BRANCH(cmp)                   \
+    vsp -= 2;                                         \
+    if (!(vsp[0] cmp vsp[1]))                         \
+    {                                                 \
+        pc = static_cast<size_t>(code[pc].operand);   \
+        RPN_DISPATCH();                               \
+    }                                                 \
+    RPN_NEXT();
+        op_JUMP_FALSE_EQ:
+            RPN_COMPARE_AND_BRANCH(==)
+        op_JUMP_FALSE_GT:
+            RPN_COMPARE_AND_BRANCH(>)
+        op_JUMP_FALSE_LT:
+            RPN_COMPARE_AND_BRANCH(<)
+        op_JUMP_FALSE_NE:
+            RPN_COMPARE_AND_BRANCH(!=)
+#undef RPN_COMPARE_AND_BRANCH
+        op_END:;
+        }
+        catch (const std::runtime_error &e)
+        {
+            m_pc = pc;
+            throw std::runtime_error("Interpreter Error (Source Line " + std::to_string(code[pc].line_num) +
+                                     ", RPN PC " + std::to_string(pc) + "): " + e.what());
+        }
+        m_pc = pc;
+#undef RPN_NEXT
+#undef RPN_DISPATCH
+#undef RPN_SYNC_IN
+#undef RPN_SYNC_OUT
+    }
+
+private:
+    // Plain int value stack; lvalue references (variable or array slots) live on a separate stack,
+    // the array index of an element reference is the value on top of the value stack
+    std::vector<int> m_valueStack;
+    std::vector<int> m_refStack;
+    std::vector<int> m_variables;             // Flat frame indexed by SymbolInfo::slot
+    ArrayHeap m_arrays;                       // Indexed by SymbolInfo::slot
+    std::vector<std::string> m_variableNames; // Slot -> name, only for error messages
+
+    const std::vector<RPNEntry> &m_rpn;
+    const SymbolTable &m_symbolTable;
+    size_t m_pc;
+    size_t m_valueTop;
+    size_t m_refTop;
+    std::vector<void *> m_threadedCode; // Handler addresses per RPN entry for run_threaded()
+
+    // No bounds checks: depths are verified by compute_stack_layout() in the constructor
+    void push_value(int val) { m_valueStack[m_valueTop++] = val; }
+    int pop_value() { return m_valueStack[--m_valueTop]; }
+    void push_ref(int slot) { m_refStack[m_refTop++] = slot; }
+    int pop_ref() { return m_refStack[--m_refTop]; }
+
+    void handle_array_assign()
+    {
+        int value_to_assign = pop_value();
+        int index = pop_value();
+        int slot = pop_ref();
+        m_arrays.at(slot, index) = value_to_assign;
+    }
+
+    void handle_array_access()
+    {
+        int index = pop_value();
+        int slot = pop_ref();
+        push_value(m_arrays.at(slot, index));
+    }
+
+    void handle_input(const RPNEntry &entry)
+    {
+        int val = read_input_value();
+
+        if (entry.opcode == RPNOpcode::INPUT)
+        {
+            m_variables[pop_ref()] = val;
+        }
+        else // RPNOpcode::INPUT_ARRAY
+        {
+            int index = pop_value();
+            int slot = pop_ref();
+            m_arrays.at(slot, index, true) = val;
+        }
+    }
+
+    void handle_output()
+    {
+        write_output_value(pop_value());
+    }
+
+    void handle_trig_function(const RPNEntry &entry)
+    {
+        push_value(evaluate_trig_function(entry.opcode, pop_value()));
+    }
+
+    void print_operand_stack_debug()
+    {
+        std::cout << "  Interpreter Operand Stack (PC " << m_pc << "): [";
+        for (size_t i = 0; i < m_valueTop; ++i)
+        {
+            std::cout << m_valueStack[i];
+            if (i + 1 < m_valueTop)
+                std::cout << ", ";
+        }
+        std::cout << "] Refs: [";
+        for (size_t i = 0; i < m_refTop; ++i)
+        {
+            std::cout << m_refStack[i];
+            if (i + 1 < m_refTop)
+                std::cout << ", ";
+        }
+        std::cout << "]" << std::endl;
+    }
+};
+
+// --- Регистровая машина: альтернативный механизм выполнения ---
+//
+// ОПЗ переводится в трёхадресный код над виртуальными регистрами. Операнды инструкций — индексы
+// в едином массиве значений [переменные | константы | регистры | ячейки вытеснения], поэтому
+// `x = y + 1` выполняется одной инструкцией ADD вместо пяти записей стековой ОПЗ.
+
+enum class RegOpcode : unsigned char
+{
+    MOV, // dst = a
+    ADD, // dst = a + b (and so on for the other binary operations)
+    SUB,
+    MUL,
+    DIV,
+    CMP_EQ,
+    CMP_GT,
+    CMP_LT,
+    CMP_NE,
+    NEG,           // dst = -a
+    LOAD,          // dst = arrays[b][a]
+    STORE,         // arrays[dst][a] = b
+    LOAD_UNCHECKED,  // LOAD with the index proven in bounds
+    STORE_UNCHECKED, // STORE with the index proven in bounds
+    JUMP,          // pc = dst
+    JUMP_FALSE,    // if (a == 0) pc = dst
+    JUMP_FALSE_EQ, // if (!(a == b)) pc = dst
+    JUMP_FALSE_GT,
+    JUMP_FALSE_LT,
+    JUMP_FALSE_NE,
+    INPUT,       // dst = input
+    INPUT_ARRAY, // arrays[dst][a] = input
+    OUTPUT,      // print a
+    SIN,         // dst = sin(a)
+    COS,
+    TG,
+    CTG
+};
+
+struct RegInstr
+{
+    RegOpcode op;
+    int dst;
+    int a;
+    int b;
+    int line_num;
+    int rpn_pc; // RPN entry the instruction was lowered from, for error messages
+};
+
+struct RegisterProgram
+{
+    std::vector<RegInstr> code;
+    std::vector<int> initial_values; // Variables (0), constants, then registers and spill slots (0)
+    std::vector<std::string> variable_names;
+    std::vector<int> array_sizes; // By array slot
+    std::vector<std::string> array_names;
+    int variable_count = 0;
+    int constant_count = 0;
+    int register_count = 0; // Physical registers used, at most RegisterLowering::kRegisterFileSize
+    int spill_count = 0;
+    int temporaries = 0; // Virtual registers before allocation
+    size_t rpn_entries = 0;
+
+    std::string locationToString(int index) const
+    {
+        if (index < variable_count)
+            return variable_names[index];
+        index -= variable_count;
+        if (index < constant_count)
+            return "#" + std::to_string(initial_values[variable_count + index]);
+        index -= constant_count;
+        if (index < register_count)
+            return "r" + std::to_string(index);
+        return "s" + std::to_string(index - register_count);
+    }
+
+    std::string instrToString(const RegInstr &in) const
+    {
+        auto loc = [this](int index)
+        { return locationToString(index); };
+        switch (in.op)
+        {
+        case RegOpcode::MOV:
+            return "MOV " + loc(in.dst) + ", " + loc(in.a);
+        case RegOpcode::ADD:
+            return "ADD " + loc(in.dst) + ", " + loc(in.a) + ", " + loc(in.b);
+        case RegOpcode::SUB:
+            return "SUB " + loc(in.dst) + ", " + loc(in.a) + ", " + loc(in.b);
+        case RegOpcode::MUL:
+            return "MUL " + loc(in.dst) + ", " + loc(in.a) + ", " + loc(in.b);
+        case RegOpcode::DIV:
+            return "DIV " + loc(in.dst) + ", " + loc(in.a) + ", " + loc(in.b);
+        case RegOpcode::CMP_EQ:
+            return "CMP_EQ " + loc(in.dst) + ", " + loc(in.a) + ", " + loc(in.b);
+        case RegOpcode::CMP_GT:
+            return "CMP_GT " + loc(in.dst) + ", " + loc(in.a) + ", " + loc(in.b);
+        case RegOpcode::CMP_LT:
+            return "CMP_LT " + loc(in.dst) + ", " + loc(in.a) + ", " + loc(in.b);
+        case RegOpcode::CMP_NE:
+            return "CMP_NE " + loc(in.dst) + ", " + loc(in.a) + ", " + loc(in.b);
+        case RegOpcode::NEG:
+            return "NEG " + loc(in.dst) + ", " + loc(in.a);
+        case RegOpcode::LOAD:
+            return "LOAD " + loc(in.dst) + ", " + array_names[in.b] + "[" + loc(in.a) + "]";
+        case RegOpcode::STORE:
+            return "STORE " + array_names[in.dst] + "[" + loc(in.a) + "], " + loc(in.b);
+        case RegOpcode::LOAD_UNCHECKED:
+            return "LOAD_UNCHECKED " + loc(in.dst) + ", " + array_names[in.b] + "[" + loc(in.a) + "]";
+        case RegOpcode::STORE_UNCHECKED:
+            return "STORE_UNCHECKED " + array_names[in.dst] + "[" + loc(in.a) + "], " + loc(in.b);
+        case RegOpcode::JUMP:
+            return "JUMP " + std::to_string(in.dst);
+        case RegOpcode::JUMP_FALSE:
+            return "JUMP_FALSE " + loc(in.a) + ", " + std::to_string(in.dst);
+        case RegOpcode::JUMP_FALSE_EQ:
+            return "JUMP_FALSE_EQ " + loc(in.a) + ", " + loc(in.b) + ", " + std::to_string(in.dst);
+        case RegOpcode::JUMP_FALSE_GT:
+            return "JUMP_FALSE_GT " + loc(in.a) + ", " + loc(in.b) + ", " + std::to_string(in.dst);
+        case RegOpcode::JUMP_FALSE_LT:
+            return "JUMP_FALSE_LT " + loc(in.a) + ", " + loc(in.b) + ", " + std::to_string(in.dst);
+        case RegOpcode::JUMP_FALSE_NE:
+            return "JUMP_FALSE_NE " + loc(in.a) + ", " + loc(in.b) + ", " + std::to_string(in.dst);
+        case RegOpcode::INPUT:
+            return "INPUT " + loc(in.dst);
+        case RegOpcode::INPUT_ARRAY:
+            return "INPUT " + array_names[in.dst] + "[" + loc(in.a) + "]";
+        case RegOpcode::OUTPUT:
+            return "OUTPUT " + loc(in.a);
+        case RegOpcode::SIN:
+            return "SIN " + loc(in.dst) + ", " + loc(in.a);
+        case RegOpcode::COS:
+            return "COS " + loc(in.dst) + ", " + loc(in.a);
+        case RegOpcode::TG:
+            return "TG " + loc(in.dst) + ", " + loc(in.a);
+        case RegOpcode::CTG:
+            return "CTG " + loc(in.dst) + ", " + loc(in.a);
+        }
+        return "UNKNOWN_REG_OPCODE";
+    }
+};
+
+// Lowers stack RPN (fused or not) to three-address code, then maps virtual registers
+// onto a fixed register file with linear-scan allocation
+class RegisterLowering
+{
+public:
+    static const int kRegisterFileSize = 8;
+
+    RegisterLowering(const std::vector<RPNEntry> &rpn, const SymbolTable &symbolTable)
+        : m_rpn(rpn), m_symbolTable(symbolTable) {}
+
+    RegisterProgram lower()
+    {
+        RegisterProgram program;
+        program.rpn_entries = m_rpn.size();
+        for (const SymbolInfo &info : m_symbolTable)
+        {
+            if (!info.is_declared || info.slot < 0)
+                continue;
+            size_t slot = static_cast<size_t>(info.slot);
+            if (info.s_class == SymbolClass::INT_VAR)
+            {
+                if (program.variable_names.size() <= slot)
+                    program.variable_names.resize(slot + 1);
+                program.variable_names[slot] = info.name;
+            }
+            else if (info.s_class == SymbolClass::INT_ARRAY)
+            {
+                if (program.array_sizes.size() <= slot)
+                {
+                    program.array_sizes.resize(slot + 1, 0);
+                    program.array_names.resize(slot + 1);
+                }
+                program.array_sizes[slot] = info.size;
+                program.array_names[slot] = info.name;
+            }
+        }
+        program.variable_count = static_cast<int>(program.variable_names.size());
+
+        translate();
+        allocate_registers(program);
+        program.constant_count = static_cast<int>(m_constants.size());
+        program.temporaries = static_cast<int>(m_temps.size());
+
+        program.initial_values.assign(program.variable_count, 0);
+        program.initial_values.insert(program.initial_values.end(), m_constants.begin(), m_constants.end());
+        program.initial_values.resize(program.initial_values.size() + program.register_count + program.spill_count, 0);
+
+        int const_base = program.variable_count;
+        int reg_base = const_base + program.constant_count;
+        int spill_base = reg_base + program.register_count;
+        auto resolve = [&](const Loc &loc) -> int
+        {
+            switch (loc.kind)
+            {
+            case LocKind::VAR:
+            case LocKind::ARRAY:
+                return loc.index;
+            case LocKind::CONST:
+                return const_base + loc.index;
+            case LocKind::TEMP:
+                return m_temps[loc.index].spill_slot >= 0 ? spill_base + m_temps[loc.index].spill_slot
+                                                          : reg_base + m_temps[loc.index].reg;
+            case LocKind::LABEL:
+                return m_rpnToInstr[loc.index];
+            case LocKind::NONE:
+                break;
+            }
+            return 0;
+        };
+        program.code.reserve(m_ir.size());
+        for (const IRInstr &ir : m_ir)
+            program.code.push_back({ir.op, resolve(ir.dst), resolve(ir.a), resolve(ir.b), ir.line_num, ir.rpn_pc});
+        return program;
+    }
+
+private:
+    enum class LocKind
+    {
+        NONE,
+        VAR,   // Variable slot
+        CONST, // Index into the constant pool
+        TEMP,  // Virtual register
+        ARRAY, // Array slot
+        LABEL  // RPN index of a jump target
+    };
+    struct Loc
+    {
+        LocKind kind = LocKind::NONE;
+        int index = 0;
+    };
+    struct IRInstr
+    {
+        RegOpcode op;
+        Loc dst, a, b;
+        int line_num;
+        int rpn_pc;
+    };
+    struct Temp
+    {
+        int start = 0; // Defining instruction
+        int end = 0;   // Last (only) use
+        int reg = -1;
+        int spill_slot = -1;
+    };
+
+    const std::vector<RPNEntry> &m_rpn;
+    const SymbolTable &m_symbolTable;
+    std::vector<IRInstr> m_ir;
+    std::vector<Temp> m_temps;
+    std::vector<int> m_constants;
+    std::unordered_map<int, int> m_constantIndex;
+    std::vector<int> m_rpnToInstr;
+
+    Loc constant(int value)
+    {
+        auto it = m_constantIndex.find(value);
+        if (it != m_constantIndex.end())
+            return {LocKind::CONST, it->second};
+        int index = static_cast<int>(m_constants.size());
+        m_constants.push_back(value);
+        m_constantIndex[value] = index;
+        return {LocKind::CONST, index};
+    }
+
+    Loc new_temp()
+    {
+        m_temps.push_back(Temp{});
+        return {LocKind::TEMP, static_cast<int>(m_temps.size()) - 1};
+    }
+
+    void emit(RegOpcode op, Loc dst, Loc a, Loc b, const RPNEntry &entry, size_t pc)
+    {
+        int index = static_cast<int>(m_ir.size());
+        for (const Loc *use : {&a, &b})
+        {
+            if (use->kind == LocKind::TEMP)
+                m_temps[use->index].end = index;
+        }
+        if (dst.kind == LocKind::TEMP)
+            m_temps[dst.index].start = m_temps[dst.index].end = index;
+        m_ir.push_back({op, dst, a, b, entry.line_num, static_cast<int>(pc)});
+    }
+
+    static RegOpcode binary_opcode(RPNOpcode op)
+    {
+        switch (op)
+        {
+        case RPNOpcode::ADD:
+            return RegOpcode::ADD;
+        case RPNOpcode::SUB:
+            return RegOpcode::SUB;
+        case RPNOpcode::MUL:
+            return RegOpcode::MUL;
+        case RPNOpcode::DIV:
+            return RegOpcode::DIV;
+        case RPNOpcode::CMP_EQ:
+            return RegOpcode::CMP_EQ;
+        case RPNOpcode::CMP_GT:
+            return RegOpcode::CMP_GT;
+        case RPNOpcode::CMP_LT:
+            return RegOpcode::CMP_LT;
+        default:
+            return RegOpcode::CMP_NE;
+        }
+    }
+
+    static RegOpcode branch_opcode(RPNOpcode op)
+    {
+        switch (op)
+        {
+        case RPNOpcode::CMP_EQ:
+        case RPNOpcode::JUMP_FALSE_EQ:
+            return RegOpcode::JUMP_FALSE_EQ;
+        case RPNOpcode::CMP_GT:
+        case RPNOpcode::JUMP_FALSE_GT:
+            return RegOpcode::JUMP_FALSE_GT;
+        case RPNOpcode::CMP_LT:
+        case RPNOpcode::JUMP_FALSE_LT:
+            return RegOpcode::JUMP_FALSE_LT;
+        default:
+            return RegOpcode::JUMP_FALSE_NE;
+        }
+    }
+
+    // Simulates the operand stack at compile time: loads and constants become operands, not instructions
+    void translate()
+    {
+        std::vector<bool> is_target = rpn_jump_targets(m_rpn);
+        std::vector<Loc> values;
+        std::vector<int> refs;
+        m_rpnToInstr.assign(m_rpn.size() + 1, 0);
+
+        auto pop = [&values]()
+        {
+            Loc loc = values.back();
+            values.pop_back();
+            return loc;
+        };
+
+        for (size_t pc = 0; pc < m_rpn.size(); ++pc)
+        {
+            const RPNEntry &entry = m_rpn[pc];
+            m_rpnToInstr[pc] = static_cast<int>(m_ir.size());
+            if (is_target[pc] && !values.empty())
+            {
+                throw std::runtime_error("Register Lowering Error: Operand stack is not empty at jump target " + std::to_string(pc) + ".");
+            }
+            RPNStackEffect effect = rpn_stack_effect(entry.opcode);
+            if (static_cast<int>(values.size()) < effect.pop_values || static_cast<int>(refs.size()) < effect.pop_refs)
+            {
+                throw std::runtime_error("Register Lowering Error: Operand stack underflow at RPN PC " + std::to_string(pc) + ".");
+            }
+
+            switch (entry.opcode)
+            {
+            case RPNOpcode::LOAD_VAR:
+                values.push_back({LocKind::VAR, entry.operand});
+                break;
+            case RPNOpcode::PUSH_CONST:
+                values.push_back(constant(entry.operand));
+                break;
+            case RPNOpcode::PUSH_VAR_REF:
+            case RPNOpcode::PUSH_ARRAY:
+                refs.push_back(entry.operand);
+                break;
+            case RPNOpcode::ADD:
+            case RPNOpcode::SUB:
+            case RPNOpcode::MUL:
+            case RPNOpcode::DIV:
+            case RPNOpcode::CMP_EQ:
+            case RPNOpcode::CMP_GT:
+            case RPNOpcode::CMP_LT:
+            case RPNOpcode::CMP_NE:
+            {
+                Loc b = pop();
+                Loc a = pop();
+                bool is_compare = entry.opcode == RPNOpcode::CMP_EQ || entry.opcode == RPNOpcode::CMP_GT ||
+                                  entry.opcode == RPNOpcode::CMP_LT || entry.opcode == RPNOpcode::CMP_NE;
+                if (is_compare && pc + 1 < m_rpn.size() && !is_target[pc + 1] && m_rpn[pc + 1].opcode == RPNOpcode::JUMP_FALSE)
+                {
+                    // Compare and branch without materialising the condition
+                    emit(branch_opcode(entry.opcode), {LocKind::LABEL, m_rpn[pc + 1].operand}, a, b, m_rpn[pc + 1], pc + 1);
+                    ++pc;
+                    m_rpnToInstr[pc] = static_cast<int>(m_ir.size()) - 1;
+                    break;
+                }
+                Loc t = new_temp();
+                emit(binary_opcode(entry.opcode), t, a, b, entry, pc);
+                values.push_back(t);
+                break;
+            }
+            case RPNOpcode::NEG:
+            case RPNOpcode::SIN:
+            case RPNOpcode::COS:
+            case RPNOpcode::TG:
+            case RPNOpcode::CTG:
+            {
+                Loc a = pop();
+                Loc t = new_temp();
+                RegOpcode op = entry.opcode == RPNOpcode::NEG   ? RegOpcode::NEG
+                               : entry.opcode == RPNOpcode::SIN ? RegOpcode::SIN
+                               : entry.opcode == RPNOpcode::COS ? RegOpcode::COS
+                               : entry.opcode == RPNOpcode::TG  ? RegOpcode::TG
+                                                                : RegOpcode::CTG;
+                emit(op, t, a, Loc{}, entry, pc);
+                values.push_back(t);
+                break;
+            }
+            case RPNOpcode::ASSIGN:
+            {
+                Loc value = pop();
+                Loc target{LocKind::VAR, refs.back()};
+                refs.pop_back();
+                // x = <expr>: the instruction that produced the temporary writes straight into x
+                if (value.kind == LocKind::TEMP && !m_ir.empty() && m_ir.back().dst.kind == LocKind::TEMP &&
+                    m_ir.back().dst.index == value.index)
+                {
+                    m_ir.back().dst = target;
+                }
+                else
+                {
+                    emit(RegOpcode::MOV, target, value, Loc{}, entry, pc);
+                }
+                break;
+            }
+            case RPNOpcode::ARRAY_ASSIGN:
+            case RPNOpcode::ARRAY_ASSIGN_UNCHECKED:
+            {
+                Loc value = pop();
+                Loc index = pop();
+                RegOpcode op = entry.opcode == RPNOpcode::ARRAY_ASSIGN ? RegOpcode::STORE : RegOpcode::STORE_UNCHECKED;
+                emit(op, {LocKind::ARRAY, refs.back()}, index, value, entry, pc);
+                refs.pop_back();
+                break;
+            }
+            case RPNOpcode::ARRAY_LOAD:
+            case RPNOpcode::ARRAY_LOAD_UNCHECKED:
+            {
+                Loc index = pop();
+                Loc t = new_temp();
+                RegOpcode op = entry.opcode == RPNOpcode::ARRAY_LOAD ? RegOpcode::LOAD : RegOpcode::LOAD_UNCHECKED;
+                emit(op, t, index, {LocKind::ARRAY, refs.back()}, entry, pc);
+                refs.pop_back();
+                values.push_back(t);
+                break;
+            }
+            case RPNOpcode::JUMP:
+                emit(RegOpcode::JUMP, {LocKind::LABEL, entry.operand}, Loc{}, Loc{}, entry, pc);
+                break;
+            case RPNOpcode::JUMP_FALSE:
+            {
+                Loc condition = pop();
+                emit(RegOpcode::JUMP_FALSE, {LocKind::LABEL, entry.operand}, condition, Loc{}, entry, pc);
+                break;
+            }
+            case RPNOpcode::INPUT:
+                emit(RegOpcode::INPUT, {LocKind::VAR, refs.back()}, Loc{}, Loc{}, entry, pc);
+                refs.pop_back();
+                break;
+            case RPNOpcode::INPUT_ARRAY:
+            {
+                Loc index = pop();
+                emit(RegOpcode::INPUT_ARRAY, {LocKind::ARRAY, refs.back()}, index, Loc{}, entry, pc);
+                refs.pop_back();
+                break;
+            }
+            case RPNOpcode::OUTPUT:
+                emit(RegOpcode::OUTPUT, Loc{}, pop(), Loc{}, entry, pc);
+                break;
+            case RPNOpcode::LOAD_ADD_CONST:
+            {
+                Loc t = new_temp();
+                emit(RegOpcode::ADD, t, {LocKind::VAR, entry.operand}, constant(entry.operand2), entry, pc);
+                values.push_back(t);
+                break;
+            }
+            case RPNOpcode::LOAD_ARRAY_VAR:
+            case RPNOpcode::LOAD_ARRAY_VAR_UNCHECKED:
+            {
+                Loc t = new_temp();
+                RegOpcode op = entry.opcode == RPNOpcode::LOAD_ARRAY_VAR ? RegOpcode::LOAD : RegOpcode::LOAD_UNCHECKED;
+                emit(op, t, {LocKind::VAR, entry.operand2}, {LocKind::ARRAY, entry.operand}, entry, pc);
+                values.push_back(t);
+                break;
+            }
+            case RPNOpcode::JUMP_FALSE_EQ:
+            case RPNOpcode::JUMP_FALSE_GT:
+            case RPNOpcode::JUMP_FALSE_LT:
+            case RPNOpcode::JUMP_FALSE_NE:
+            {
+                Loc b = pop();
+                Loc a = pop();
+                emit(branch_opcode(entry.opcode), {LocKind::LABEL, entry.operand}, a, b, entry, pc);
+                break;
+            }
+            }
+        }
+        m_rpnToInstr[m_rpn.size()] = static_cast<int>(m_ir.size());
+        if (!values.empty() || !refs.empty())
+            throw std::runtime_error("Register Lowering Error: Operand stack is not empty at the end of the program.");
+    }
+
+    // Linear scan (Poletto & Sarkar): temporaries are visited in order of definition; when all
+    // registers are busy, the interval that ends last goes to a spill slot
+    void allocate_registers(RegisterProgram &program)
+    {
+        std::vector<int> active; // Temps holding a register, sorted by end
+        std::vector<int> free_registers;
+        for (int r = kRegisterFileSize - 1; r >= 0; --r)
+            free_registers.push_back(r);
+        int used_registers = 0;
+        int spill_slots = 0;
+
+        for (size_t t = 0; t < m_temps.size(); ++t)
+        {
+            Temp &current = m_temps[t];
+            // A temp whose last use is the defining instruction of `current` is read before the write
+            while (!active.empty() && m_temps[active.front()].end <= current.start)
+            {
+                free_registers.push_back(m_temps[active.front()].reg);
+                active.erase(active.begin());
+            }
+
+            if (free_registers.empty())
+            {
+                Temp &last = m_temps[active.back()];
+                if (last.end > current.end)
+                {
+                    current.reg = last.reg;
+                    last.reg = -1;
+                    last.spill_slot = spill_slots++;
+                    active.pop_back();
+                }
+                else
+                {
+                    current.spill_slot = spill_slots++;
+                    continue;
+                }
+            }
+            else
+            {
+                current.reg = free_registers.back();
+                free_registers.pop_back();
+            }
+            used_registers = std::max(used_registers, current.reg + 1);
+            auto pos = std::upper_bound(active.begin(), active.end(), current.end,
+                                        [this](int end, int other)
+                                        { return end < m_temps[other].end; });
+            active.insert(pos, static_cast<int>(t));
+        }
+        program.register_count = used_registers;
+        program.spill_count = spill_slots;
+    }
+};
+
+// Executes RegisterProgram; output and errors match RPNInterpreter on the same RPN
+class RegisterVM
+{
+public:
+    explicit RegisterVM(const RegisterProgram &program) : m_program(program), m_values(program.initial_values)
+    {
+        m_arrays.build(program.array_sizes, program.array_names);
+    }
+
+    void run()
+    {
+        const RegInstr *code = m_program.code.data();
+        const size_t code_size = m_program.code.size();
+        int *v = m_values.data();
+        size_t pc = 0;
+        try
+        {
+            while (pc < code_size)
+            {
+                const RegInstr &in = code[pc];
+                switch (in.op)
+                {
+                case RegOpcode::MOV:
+                    v[in.dst] = v[in.a];
+                    break;
+                case RegOpcode::ADD:
+                    v[in.dst] = wrapping_add(v[in.a], v[in.b]);
+                    break;
+                case RegOpcode::SUB:
+                    v[in.dst] = wrapping_sub(v[in.a], v[in.b]);
+                    break;
+                case RegOpcode::MUL:
+                    v[in.dst] = wrapping_mul(v[in.a], v[in.b]);
+                    break;
+                case RegOpcode::DIV:
+                    if (v[in.b] == 0)
+                        throw std::runtime_error("Division by zero.");
+                    v[in.dst] = v[in.a] / v[in.b];
+                    break;
+                case RegOpcode::CMP_EQ:
+                    v[in.dst] = v[in.a] == v[in.b] ? 1 : 0;
+                    break;
+                case RegOpcode::CMP_GT:
+                    v[in.dst] = v[in.a] > v[in.b] ? 1 : 0;
+                    break;
+                case RegOpcode::CMP_LT:
+                    v[in.dst] = v[in.a] < v[in.b] ? 1 : 0;
+                    break;
+                case RegOpcode::CMP_NE:
+                    v[in.dst] = v[in.a] != v[in.b] ? 1 : 0;
+                    break;
+                case RegOpcode::NEG:
+                    v[in.dst] = wrapping_neg(v[in.a]);
+                    break;
+                case RegOpcode::LOAD:
+                    v[in.dst] = m_arrays.at(in.b, v[in.a]);
+                    break;
+                case RegOpcode::STORE:
+                    m_arrays.at(in.dst, v[in.a]) = v[in.b];
+                    break;
+                case RegOpcode::LOAD_UNCHECKED:
+                    v[in.dst] = m_arrays.element(in.b, v[in.a]);
+                    break;
+                case RegOpcode::STORE_UNCHECKED:
+                    m_arrays.element(in.dst, v[in.a]) = v[in.b];
+                    break;
+                case RegOpcode::JUMP:
+                    pc = static_cast<size_t>(in.dst);
+                    continue;
+                case RegOpcode::JUMP_FALSE:
+                    if (v[in.a] == 0)
+                    {
+                        pc = static_cast<size_t>(in.dst);
+                        continue;
+                    }
+                    break;
+                case RegOpcode::JUMP_FALSE_EQ:
+                    if (!(v[in.a] == v[in.b]))
+                    {
+                        pc = static_cast<size_t>(in.dst);
+                        continue;
+                    }
+                    break;
+                case RegOpcode::JUMP_FALSE_GT:
+                    if (!(v[in.a] > v[in.b]))
+                    {
+                        pc = static_cast<size_t>(in.dst);
+                        continue;
+                    }
+                    break;
+                case RegOpcode::JUMP_FALSE_LT:
+                    if (!(v[in.a] < v[in.b]))
+                    {
+                        pc = static_cast<size_t>(in.dst);
+                        continue;
+                    }
+                    break;
+                case RegOpcode::JUMP_FALSE_NE:
+                    if (!(v[in.a] != v[in.b]))
+                    {
+                        pc = static_cast<size_t>(in.dst);
+                        continue;
+                    }
+                    break;
+                case RegOpcode::INPUT:
+                    v[in.dst] = read_input_value();
+                    break;
+                case RegOpcode::INPUT_ARRAY:
+                {
+                    int val = read_input_value();
+                    m_arrays.at(in.dst, v[in.a], true) = val;
+                    break;
+                }
+                case RegOpcode::OUTPUT:
+                    write_output_value(v[in.a]);
+                    break;
+                case RegOpcode::SIN:
+                    v[in.dst] = evaluate_trig_function(RPNOpcode::SIN, v[in.a]);
+                    break;
+                case RegOpcode::COS:
+                    v[in.dst] = evaluate_trig_function(RPNOpcode::COS, v[in.a]);
+                    break;
+                case RegOpcode::TG:
+                    v[in.dst] = evaluate_trig_function(RPNOpcode::TG, v[in.a]);
+                    break;
+                case RegOpcode::CTG:
+                    v[in.dst] = evaluate_trig_function(RPNOpcode::CTG, v[in.a]);
+                    break;
+                }
+                ++pc;
+            }
+        }
+        catch (const std::runtime_error &e)
+        {
+            throw std::runtime_error("Interpreter Error (Source Line " + std::to_string(code[pc].line_num) +
+                                     ", RPN PC " + std::to_string(code[pc].rpn_pc) + "): " + e.what());
+        }
+    }
+
+private:
+    const RegisterProgram &m_program;
+    std::vector<int> m_values;
+    ArrayHeap m_arrays;
+};
+
+// --- JIT-компиляция ОПЗ в машинный код x86-64 ---
+//
+// Каждая запись ОПЗ превращается в короткую последовательность команд. Глубина стека перед каждой
+// записью известна статически (compute_stack_layout), поэтому ячейки стека адресуются как
+// [r13 + 4*depth], переменные — [r12 + 4*slot]; в C++ уходят только ввод/вывод и тригонометрия.
+// Ошибки не пробрасываются сквозь сгенерированный код: он возвращает код статуса, а сообщение
+// формируется уже в C++ тем же текстом, что и в интерпретаторе.
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define RPN_JIT_SUPPORTED 1
+#else
+#define RPN_JIT_SUPPORTED 0
+#endif
+
+enum class JitStatus : int
+{
+    OK = 0,
+    DIVISION_BY_ZERO,
+    INDEX_OUT_OF_BOUNDS,
+    INPUT_INDEX_OUT_OF_BOUNDS,
+    RUNTIME_CALL_FAILED // Message is in JitContext::error_message
+};
+
+// Shared between generated code and C++; field offsets are baked into the code
+struct JitContext
+{
+    int *variables;
+    int *arrays; // ArrayHeap base; offsets and lengths are baked into the code
+    int *stack;
+    int call_result; // Value returned by jit_runtime_call()
+    int error_pc;
+    int error_slot;
+    int error_index;
+    std::string *error_message;
+};
+
+// The only entry point generated code calls: input, output and trig functions (kind is an RPNOpcode).
+// Never throws; a non-zero result makes the generated code stop with RUNTIME_CALL_FAILED
+static int jit_runtime_call(JitContext *ctx, int kind, int arg)
+{
+    try
+    {
+        switch (static_cast<RPNOpcode>(kind))
+        {
+        case RPNOpcode::INPUT:
+            ctx->call_result = read_input_value();
+            break;
+        case RPNOpcode::OUTPUT:
+            write_output_value(arg);
+            break;
+        default:
+            ctx->call_result = evaluate_trig_function(static_cast<RPNOpcode>(kind), arg);
+            break;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        *ctx->error_message = e.what();
+        return 1;
+    }
+    return 0;
+}
+
+// Read-write while the code is copied in, then read-execute
+class ExecutableBuffer
+{
+public:
+    ExecutableBuffer() : m_memory(nullptr), m_size(0) {}
+
+    void load(const std::vector<unsigned char> &code)
+    {
+        m_size = code.size() ? code.size() : 1;
+#ifdef _WIN32
+        m_memory = VirtualAlloc(nullptr, m_size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        if (!m_memory)
+            throw std::runtime_error("JIT Error: VirtualAlloc failed.");
+        std::memcpy(m_memory, code.data(), code.size());
+        DWORD old_protect;
+        if (!VirtualProtect(m_memory, m_size, PAGE_EXECUTE_READ, &old_protect))
+        {
+            VirtualFree(m_memory, 0, MEM_RELEASE);
+            m_memory = nullptr;
+            throw std::runtime_error("JIT Error: VirtualProtect failed.");
+        }
+        FlushInstructionCache(GetCurrentProcess(), m_memory, m_size);
+#else
+        m_memory = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (m_memory == MAP_FAILED)
+        {
+            m_memory = nullptr;
+            throw std::runtime_error("JIT Error: mmap failed.");
+        }
+        std::memcpy(m_memory, code.data(), code.size());
+        if (mprotect(m_memory, m_size, PROT_READ | PROT_EXEC) != 0)
+        {
+            munmap(m_memory, m_size);
+            m_memory = nullptr;
+            throw std::runtime_error("JIT Error: mprotect failed.");
+        }
+#endif
+    }
+
+    ~ExecutableBuffer()
+    {
+        if (!m_memory)
+            return;
+#ifdef _WIN32
+        VirtualFree(m_memory, 0, MEM_RELEASE);
+#else
+        munmap(m_memory, m_size);
+#endif
+    }
+
+    ExecutableBuffer(const ExecutableBuffer &) = delete;
+    ExecutableBuffer &operator=(const ExecutableBuffer &) = delete;
+
+    void *data() const { return m_memory; }
+
+private:
+    void *m_memory;
+    size_t m_size;
+};
+
+// Minimal x86-64 encoder: only the forms RPNJit needs. Memory operands are always [base + disp32]
+class X86Emitter
+{
+public:
+    enum Reg
+    {
+        RAX = 0,
+        RCX = 1,
+        RDX = 2,
+        RBX = 3,
+        RSP = 4,
+        RSI = 6,
+        RDI = 7,
+        R8 = 8,
+        R12 = 12,
+        R13 = 13,
+        R14 = 14
+    };
+    enum Cond
+    {
+        CC_B = 0x2,
+        CC_AE = 0x3,
+        CC_E = 0x4,
+        CC_NE = 0x5,
+        CC_L = 0xC,
+        CC_GE = 0xD,
+        CC_LE = 0xE,
+        CC_G = 0xF
+    };
+
+    std::vector<unsigned char> code;
+
+    size_t size() const { return code.size(); }
+
+    void byte(unsigned char b) { code.push_back(b); }
+    void bytes(std::initializer_list<unsigned char> list) { code.insert(code.end(), list.begin(), list.end()); }
+    void dword(int value)
+    {
+        unsigned int v = static_cast<unsigned int>(value);
+        for (int i = 0; i < 4; ++i)
+            byte(static_cast<unsigned char>(v >> (8 * i)));
+    }
+    void qword(unsigned long long value)
+    {
+        for (int i = 0; i < 8; ++i)
+            byte(static_cast<unsigned char>(value >> (8 * i)));
+    }
+
+    // <opcode> reg, [base + disp32]
+    void op_mem(std::initializer_list<unsigned char> opcode, bool wide, int reg, int base, int disp)
+    {
+        rex(wide, reg, base);
+        bytes(opcode);
+        byte(static_cast<unsigned char>(0x80 | ((reg & 7) << 3) | (base & 7)));
+        if ((base & 7) == RSP)
+            byte(0x24); // SIB: no index (needed for rsp/r12 as base)
+        dword(disp);
+    }
+    void mov_load(int reg, int base, int disp) { op_mem({0x8B}, false, reg, base, disp); }
+    void mov_load64(int reg, int base, int disp) { op_mem({0x8B}, true, reg, base, disp); }
+    void lea64(int reg, int base, int disp) { op_mem({0x8D}, true, reg, base, disp); }
+    void mov_store(int base, int disp, int reg) { op_mem({0x89}, false, reg, base, disp); }
+    void mov_store_imm(int base, int disp, int imm)
+    {
+        op_mem({0xC7}, false, 0, base, disp);
+        dword(imm);
+    }
+    void add_load(int reg, int base, int disp) { op_mem({0x03}, false, reg, base, disp); }
+    void sub_load(int reg, int base, int disp) { op_mem({0x2B}, false, reg, base, disp); }
+    void imul_load(int reg, int base, int disp) { op_mem({0x0F, 0xAF}, false, reg, base, disp); }
+    void cmp_load(int reg, int base, int disp) { op_mem({0x3B}, false, reg, base, disp); }
+    void neg_mem(int base, int disp) { op_mem({0xF7}, false, 3, base, disp); }
+
+    void mov_reg64(int dst, int src)
+    {
+        byte(static_cast<unsigned char>(0x48 | ((src >> 3) << 2) | (dst >> 3)));
+        byte(0x89);
+        byte(static_cast<unsigned char>(0xC0 | ((src & 7) << 3) | (dst & 7)));
+    }
+    void mov_imm(int reg, int imm)
+    {
+        if (reg >= 8)
+            byte(0x41);
+        byte(static_cast<unsigned char>(0xB8 + (reg & 7)));
+        dword(imm);
+    }
+    void zero(int reg)
+    {
+        if (reg >= 8)
+            byte(0x45);
+        byte(0x31);
+        byte(static_cast<unsigned char>(0xC0 | ((reg & 7) << 3) | (reg & 7)));
+    }
+    void add_eax_imm(int imm)
+    {
+        byte(0x05);
+        dword(imm);
+    }
+    void cmp_eax_imm(int imm)
+    {
+        byte(0x3D);
+        dword(imm);
+    }
+    void test_eax() { bytes({0x85, 0xC0}); }
+    void test_ecx() { bytes({0x85, 0xC9}); }
+    void cdq_idiv_ecx() { bytes({0x99, 0xF7, 0xF9}); }
+    void setcc_eax(Cond cc) { bytes({0x0F, static_cast<unsigned char>(0x90 | cc), 0xC0, 0x0F, 0xB6, 0xC0}); } // setcc al; movzx eax, al
+    void load_element_eax() { bytes({0x8B, 0x04, 0x82}); }                                                  // mov eax, [rdx + rax*4]
+    void store_element_ecx() { bytes({0x89, 0x0C, 0x82}); }                                                 // mov [rdx + rax*4], ecx
+    void call_absolute(const void *target)
+    {
+        bytes({0x48, 0xB8}); // mov rax, imm64
+        qword(static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(target)));
+        bytes({0xFF, 0xD0}); // call rax
+    }
+
+    // Branches return the position of their rel32 field for patch()
+    size_t jcc(Cond cc)
+    {
+        bytes({0x0F, static_cast<unsigned char>(0x80 | cc)});
+        dword(0);
+        return size() - 4;
+    }
+    size_t jmp()
+    {
+        byte(0xE9);
+        dword(0);
+        return size() - 4;
+    }
+    void patch(size_t rel32_pos, size_t target)
+    {
+        int rel = static_cast<int>(static_cast<long long>(target) - static_cast<long long>(rel32_pos + 4));
+        for (int i = 0; i < 4; ++i)
+            code[rel32_pos + i] = static_cast<unsigned char>(static_cast<unsigned int>(rel) >> (8 * i));
+    }
+
+private:
+    void rex(bool wide, int reg, int base)
+    {
+        if (wide || reg >= 8 || base >= 8)
+            byte(static_cast<unsigned char>(0x40 | (wide ? 8 : 0) | ((reg >> 3) << 2) | (base >> 3)));
+    }
+};
+
+class RPNJit
+{
+public:
+    RPNJit(const std::vector<RPNEntry> &rpn, const SymbolTable &symbolTable)
+        : m_rpn(rpn)
+    {
+        for (const SymbolInfo &info : symbolTable)
+        {
+            if (!info.is_declared || info.slot < 0)
+                continue;
+            size_t slot = static_cast<size_t>(info.slot);
+            if (info.s_class == SymbolClass::INT_VAR)
+            {
+                if (m_variables.size() <= slot)
+                    m_variables.resize(slot + 1, 0);
+            }
+        }
+        m_arrays.build(symbolTable);
+
+        RPNStackLayout layout = compute_stack_layout(m_rpn);
+        m_valueStack.assign(layout.max_value_depth, 0);
+        compile(layout);
+        m_buffer.load(m_emitter.code);
+    }
+
+    size_t nativeCodeSize() const { return m_emitter.size(); }
+
+    void run()
+    {
+#if RPN_JIT_SUPPORTED
+        JitContext ctx{};
+        ctx.variables = m_variables.data();
+        ctx.arrays = m_arrays.data();
+        ctx.stack = m_valueStack.data();
+        ctx.error_message = &m_errorMessage;
+
+        typedef int (*JitFunction)(JitContext *);
+        JitFunction function = reinterpret_cast<JitFunction>(m_buffer.data());
+        JitStatus status = static_cast<JitStatus>(function(&ctx));
+        if (status == JitStatus::OK)
+            return;
+
+        std::string message;
+        switch (status)
+        {
+        case JitStatus::DIVISION_BY_ZERO:
+            message = "Division by zero.";
+            break;
+        case JitStatus::INDEX_OUT_OF_BOUNDS:
+        case JitStatus::INPUT_INDEX_OUT_OF_BOUNDS:
+            message = m_arrays.index_error_message(ctx.error_index, ctx.error_slot, status == JitStatus::INPUT_INDEX_OUT_OF_BOUNDS);
+            break;
+        default:
+            message = m_errorMessage;
+            break;
+        }
+        throw std::runtime_error("Interpreter Error (Source Line " + std::to_string(m_rpn[ctx.error_pc].line_num) +
+                                 ", RPN PC " + std::to_string(ctx.error_pc) + "): " + message);
+#else
+        throw std::runtime_error("JIT Error: native code generation is only supported on x86-64.");
+#endif
+    }
+
+private:
+    typedef X86Emitter E;
+
+    // Callee-saved registers holding the context while generated code runs
+    static const int kContext = E::RBX;
+    static const int kVariables = E::R12;
+    static const int kStack = E::R13;
+    static const int kArrays = E::R14;
+
+#ifdef _WIN32
+    static const int kArg0 = E::RCX, kArg1 = E::RDX, kArg2 = E::R8; // Microsoft x64
+#else
+    static const int kArg0 = E::RDI, kArg1 = E::RSI, kArg2 = E::RDX; // System V AMD64
+#endif
+
+    struct ErrorExit
+    {
+        size_t branch; // rel32 of the jcc/jnz leading here
+        int pc;
+        JitStatus status;
+        int slot;
+    };
+
+    const std::vector<RPNEntry> &m_rpn;
+    std::vector<int> m_variables;
+    ArrayHeap m_arrays;
+    std::vector<int> m_valueStack;
+    std::string m_errorMessage;
+    X86Emitter m_emitter;
+    ExecutableBuffer m_buffer;
+    std::vector<ErrorExit> m_errorExits;
+
+    static int stack_slot(int depth) { return depth * static_cast<int>(sizeof(int)); }
+    static int var_slot(int slot) { return slot * static_cast<int>(sizeof(int)); }
+
+    void check_var_slot(int slot, const RPNEntry &entry) const
+    {
+        if (slot < 0 || static_cast<size_t>(slot) >= m_variables.size())
+            throw std::runtime_error("JIT Error: Invalid variable slot " + std::to_string(slot) + " for '" + entry.value + "'.");
+    }
+    void check_array_slot(int slot, const RPNEntry &entry) const
+    {
+        if (slot < 0 || static_cast<size_t>(slot) >= m_arrays.count())
+            throw std::runtime_error("JIT Error: Invalid array slot " + std::to_string(slot) + " for '" + entry.value + "'.");
+    }
+
+    void error_exit(size_t branch, int pc, JitStatus status, int slot = 0)
+    {
+        m_errorExits.push_back({branch, pc, status, slot});
+    }
+
+    // eax (index) must hold a value already loaded; leaves rdx = &array[0].
+    // Length and heap offset are immediates: no load of array metadata at run time
+    void emit_bounds_check(int slot, int pc, JitStatus status)
+    {
+        E &e = m_emitter;
+        e.cmp_eax_imm(m_arrays.extent(slot).length);
+        error_exit(e.jcc(E::CC_AE), pc, status, slot); // Unsigned compare also rejects negative indices
+        emit_array_base(slot);
+    }
+
+    // rdx = &array[0]
+    void emit_array_base(int slot)
+    {
+        m_emitter.lea64(E::RDX, kArrays, m_arrays.extent(slot).offset * static_cast<int>(sizeof(int)));
+    }
+
+    // jit_runtime_call(ctx, kind, [r13 + arg_disp] or 0); stops the program if it fails
+    void emit_runtime_call(RPNOpcode kind, int pc, bool has_arg, int arg_disp = 0)
+    {
+        E &e = m_emitter;
+        e.mov_reg64(kArg0, kContext);
+        e.mov_imm(kArg1, static_cast<int>(kind));
+        if (has_arg)
+            e.mov_load(kArg2, kStack, arg_disp);
+        else
+            e.zero(kArg2);
+        e.call_absolute(reinterpret_cast<const void *>(&jit_runtime_call));
+        e.test_eax();
+        error_exit(e.jcc(E::CC_NE), pc, JitStatus::RUNTIME_CALL_FAILED);
+    }
+
+    void compile(const RPNStackLayout &layout)
+    {
+        E &e = m_emitter;
+        const int call_result = static_cast<int>(offsetof(JitContext, call_result));
+
+        // Prologue: 4 pushes + 40 bytes keep rsp 16-byte aligned and leave 32 bytes of shadow space for Win64
+        e.byte(0x53);               // push rbx
+        e.bytes({0x41, 0x54});      // push r12
+        e.bytes({0x41, 0x55});      // push r13
+        e.bytes({0x41, 0x56});      // push r14
+        e.bytes({0x48, 0x83, 0xEC, 0x28}); // sub rsp, 40
+        e.mov_reg64(kContext, kArg0);
+        e.mov_load64(kVariables, kContext, static_cast<int>(offsetof(JitContext, variables)));
+        e.mov_load64(kStack, kContext, static_cast<int>(offsetof(JitContext, stack)));
+        e.mov_load64(kArrays, kContext, static_cast<int>(offsetof(JitContext, arrays)));
+
+        std::vector<size_t> native_offset(m_rpn.size() + 1, 0);
+        std::vector<std::pair<size_t, int>> jumps; // (rel32 position, RPN target)
+        std::vector<int> refs;                     // Reference stack, resolved at compile time
+
+        for (size_t i = 0; i < m_rpn.size(); ++i)
+        {
+            const RPNEntry &entry = m_rpn[i];
+            const int pc = static_cast<int>(i);
+            const int d = layout.value_depth[i];
+            native_offset[i] = e.size();
+
+            auto pop_ref = [&refs, &entry]()
+            {
+                if (refs.empty())
+                    throw std::runtime_error("JIT Error: Reference stack underflow at source line " + std::to_string(entry.line_num) + ".");
+                int slot = refs.back();
+                refs.pop_back();
+                return slot;
+            };
+            if (rpn_is_jump(entry.opcode))
+            {
+                if (entry.operand < 0 || static_cast<size_t>(entry.operand) > m_rpn.size())
+                    throw std::runtime_error("JIT Error: Jump from source line " + std::to_string(entry.line_num) +
+                                             " has invalid target " + std::to_string(entry.operand) + ".");
+                if (layout.ref_depth[entry.operand] != 0)
+                    throw std::runtime_error("JIT Error: References are live across the jump at RPN PC " + std::to_string(pc) + ".");
+            }
+
+            switch (entry.opcode)
+            {
+            case RPNOpcode::LOAD_VAR:
+                check_var_slot(entry.operand, entry);
+                e.mov_load(E::RAX, kVariables, var_slot(entry.operand));
+                e.mov_store(kStack, stack_slot(d), E::RAX);
+                break;
+            case RPNOpcode::PUSH_VAR_REF:
+                check_var_slot(entry.operand, entry);
+                refs.push_back(entry.operand);
+                break;
+            case RPNOpcode::PUSH_ARRAY:
+                check_array_slot(entry.operand, entry);
+                refs.push_back(entry.operand);
+                break;
+            case RPNOpcode::PUSH_CONST:
+                e.mov_store_imm(kStack, stack_slot(d), entry.operand);
+                break;
+            case RPNOpcode::ADD:
+            case RPNOpcode::SUB:
+            case RPNOpcode::MUL:
+                e.mov_load(E::RAX, kStack, stack_slot(d - 2));
+                if (entry.opcode == RPNOpcode::ADD)
+                    e.add_load(E::RAX, kStack, stack_slot(d - 1));
+                else if (entry.opcode == RPNOpcode::SUB)
+                    e.sub_load(E::RAX, kStack, stack_slot(d - 1));
+                else
+                    e.imul_load(E::RAX, kStack, stack_slot(d - 1));
+                e.mov_store(kStack, stack_slot(d - 2), E::RAX);
+                break;
+            case RPNOpcode::DIV:
+                e.mov_load(E::RCX, kStack, stack_slot(d - 1));
+                e.test_ecx();
+                error_exit(e.jcc(E::CC_E), pc, JitStatus::DIVISION_BY_ZERO);
+                e.mov_load(E::RAX, kStack, stack_slot(d - 2));
+                e.cdq_idiv_ecx();
+                e.mov_store(kStack, stack_slot(d - 2), E::RAX);
+                break;
+            case RPNOpcode::CMP_EQ:
+            case RPNOpcode::CMP_GT:
+            case RPNOpcode::CMP_LT:
+            case RPNOpcode::CMP_NE:
+                e.mov_load(E::RAX, kStack, stack_slot(d - 2));
+                e.cmp_load(E::RAX, kStack, stack_slot(d - 1));
+                e.setcc_eax(entry.opcode == RPNOpcode::CMP_EQ   ? E::CC_E
+                            : entry.opcode == RPNOpcode::CMP_GT ? E::CC_G
+                            : entry.opcode == RPNOpcode::CMP_LT ? E::CC_L
+                                                                : E::CC_NE);
+                e.mov_store(kStack, stack_slot(d - 2), E::RAX);
+                break;
+            case RPNOpcode::NEG:
+                e.neg_mem(kStack, stack_slot(d - 1));
+                break;
+            case RPNOpcode::ASSIGN:
+                e.mov_load(E::RAX, kStack, stack_slot(d - 1));
+                e.mov_store(kVariables, var_slot(pop_ref()), E::RAX);
+                break;
+            case RPNOpcode::ARRAY_ASSIGN:
+            case RPNOpcode::ARRAY_ASSIGN_UNCHECKED:
+            {
+                int slot = pop_ref();
+                e.mov_load(E::RAX, kStack, stack_slot(d - 2));
+                if (entry.opcode == RPNOpcode::ARRAY_ASSIGN)
+                    emit_bounds_check(slot, pc, JitStatus::INDEX_OUT_OF_BOUNDS);
+                else
+                    emit_array_base(slot);
+                e.mov_load(E::RCX, kStack, stack_slot(d - 1));
+                e.store_element_ecx();
+                break;
+            }
+            case RPNOpcode::ARRAY_LOAD:
+            case RPNOpcode::ARRAY_LOAD_UNCHECKED:
+            {
+                int slot = pop_ref();
+                e.mov_load(E::RAX, kStack, stack_slot(d - 1));
+                if (entry.opcode == RPNOpcode::ARRAY_LOAD)
+                    emit_bounds_check(slot, pc, JitStatus::INDEX_OUT_OF_BOUNDS);
+                else
+                    emit_array_base(slot);
+                e.load_element_eax();
+                e.mov_store(kStack, stack_slot(d - 1), E::RAX);
+                break;
+            }
+            case RPNOpcode::JUMP:
+                jumps.push_back({e.jmp(), entry.operand});
+                break;
+            case RPNOpcode::JUMP_FALSE:
+                e.mov_load(E::RAX, kStack, stack_slot(d - 1));
+                e.test_eax();
+                jumps.push_back({e.jcc(E::CC_E), entry.operand});
+                break;
+            case RPNOpcode::JUMP_FALSE_EQ:
+            case RPNOpcode::JUMP_FALSE_GT:
+            case RPNOpcode::JUMP_FALSE_LT:
+            case RPNOpcode::JUMP_FALSE_NE:
+                e.mov_load(E::RAX, kStack, stack_slot(d - 2));
+                e.cmp_load(E::RAX, kStack, stack_slot(d - 1));
+                jumps.push_back({e.jcc(entry.opcode == RPNOpcode::JUMP_FALSE_EQ   ? E::CC_NE
+                                       : entry.opcode == RPNOpcode::JUMP_FALSE_GT ? E::CC_LE
+                                       : entry.opcode == RPNOpcode::JUMP_FALSE_LT ? E::CC_GE
+                                                                                  : E::CC_E),
+                                 entry.operand});
+                break;
+            case RPNOpcode::INPUT:
+            {
+                int slot = pop_ref();
+                emit_runtime_call(RPNOpcode::INPUT, pc, false);
+                e.mov_load(E::RAX, kContext, call_result);
+                e.mov_store(kVariables, var_slot(slot), E::RAX);
+                break;
+            }
+            case RPNOpcode::INPUT_ARRAY:
+            {
+                // Input is read before the index is checked, as in RPNInterpreter::handle_input()
+                int slot = pop_ref();
+                emit_runtime_call(RPNOpcode::INPUT, pc, false);
+                e.mov_load(E::RCX, kContext, call_result);
+                e.mov_load(E::RAX, kStack, stack_slot(d - 1));
+                emit_bounds_check(slot, pc, JitStatus::INPUT_INDEX_OUT_OF_BOUNDS);
+                e.store_element_ecx();
+                break;
+            }
+            case RPNOpcode::OUTPUT:
+                emit_runtime_call(RPNOpcode::OUTPUT, pc, true, stack_slot(d - 1));
+                break;
+            case RPNOpcode::SIN:
+            case RPNOpcode::COS:
+            case RPNOpcode::TG:
+            case RPNOpcode::CTG:
+                emit_runtime_call(entry.opcode, pc, true, stack_slot(d - 1));
+                e.mov_load(E::RAX, kContext, call_result);
+                e.mov_store(kStack, stack_slot(d - 1), E::RAX);
+                break;
+            case RPNOpcode::LOAD_ADD_CONST:
+                check_var_slot(entry.operand, entry);
+                e.mov_load(E::RAX, kVariables, var_slot(entry.operand));
+                e.add_eax_imm(entry.operand2);
+                e.mov_store(kStack, stack_slot(d), E::RAX);
+                break;
+            case RPNOpcode::LOAD_ARRAY_VAR:
+            case RPNOpcode::LOAD_ARRAY_VAR_UNCHECKED:
+                check_array_slot(entry.operand, entry);
+                check_var_slot(entry.operand2, entry);
+                e.mov_load(E::RAX, kVariables, var_slot(entry.operand2));
+                if (entry.opcode == RPNOpcode::LOAD_ARRAY_VAR)
+                    emit_bounds_check(entry.operand, pc, JitStatus::INDEX_OUT_OF_BOUNDS);
+                else
+                    emit_array_base(entry.operand);
+                e.load_element_eax();
+                e.mov_store(kStack, stack_slot(d), E::RAX);
+                break;
+            }
+        }
+        native_offset[m_rpn.size()] = e.size();
+        for (const auto &jump : jumps)
+            e.patch(jump.first, native_offset[jump.second]);
+
+        // Normal completion falls through to the epilogue with status OK
+        e.zero(E::RAX);
+        size_t epilogue = e.size();
+        e.bytes({0x48, 0x83, 0xC4, 0x28}); // add rsp, 40
+        e.bytes({0x41, 0x5E});             // pop r14
+        e.bytes({0x41, 0x5D});             // pop r13
+        e.bytes({0x41, 0x5C});             // pop r12
+        e.byte(0x5B);                      // pop rbx
+        e.byte(0xC3);                      // ret
+
+        // Out-of-line error exits, off the hot path
+        for (const ErrorExit &exit : m_errorExits)
+        {
+            e.patch(exit.branch, e.size());
+            e.mov_store(kContext, static_cast<int>(offsetof(JitContext, error_index)), E::RAX);
+            e.mov_store_imm(kContext, static_cast<int>(offsetof(JitContext, error_pc)), exit.pc);
+            e.mov_store_imm(kContext, static_cast<int>(offsetof(JitContext, error_slot)), exit.slot);
+            e.mov_imm(E::RAX, static_cast<int>(exit.status));
+            e.patch(e.jmp(), epilogue);
+        }
+    }
+};
+
+// --- Генерация исходного кода на C (AOT) ---
+//
+// ОПЗ переводится в самостоятельную программу на C: ячейки стека становятся локальными
+// переменными s0..sN (глубины известны статически), переходы — goto. Поведение совпадает
+// с интерпретатором: те же сообщения об ошибках, проверки границ массивов, тригонометрия
+// в градусах с округлением, вывод "Output: N". Сборка: cc -O2 program.c -o program -lm
+
+class RPNCEmitter
+{
+public:
+    RPNCEmitter(const std::vector<RPNEntry> &rpn, const SymbolTable &symbolTable)
+        : m_rpn(rpn)
+    {
+        for (const SymbolInfo &info : symbolTable)
+        {
+            if (!info.is_declared || info.slot < 0)
+                continue;
+            size_t slot = static_cast<size_t>(info.slot);
+            if (info.s_class == SymbolClass::INT_VAR)
+            {
+                if (m_variableNames.size() <= slot)
+                    m_variableNames.resize(slot + 1);
+                m_variableNames[slot] = info.name;
+            }
+            else if (info.s_class == SymbolClass::INT_ARRAY)
+            {
+                if (m_arrayNames.size() <= slot)
+                {
+                    m_arrayNames.resize(slot + 1);
+                    m_arraySizes.resize(slot + 1, 0);
+                }
+                m_arrayNames[slot] = info.name;
+                m_arraySizes[slot] = info.size;
+            }
+        }
+    }
+
+    std::string emit(const std::string &source_name)
+    {
+        RPNStackLayout layout = compute_stack_layout(m_rpn);
+        std::vector<bool> is_target = rpn_jump_targets(m_rpn);
+        std::ostringstream out;
+
+        out << "/* Generated from " << source_name << " (" << m_rpn.size() << " RPN entries). */\n"
+            << "/* Build: cc -O2 program.c -o program -lm */\n"
+            << "#include <stdio.h>\n"
+            << "#include <stdlib.h>\n"
+            << "#include <math.h>\n"
+            << "\n"
+            << "#ifndef M_PI\n"
+            << "#define M_PI 3.14159265358979323846\n"
+            << "#endif\n"
+            << "\n"
+            << "/* Wrapping arithmetic, as the interpreter behaves on overflow */\n"
+            << "static inline int rt_add(int a, int b) { return (int)((unsigned)a + (unsigned)b); }\n"
+            << "static inline int rt_sub(int a, int b) { return (int)((unsigned)a - (unsigned)b); }\n"
+            << "static inline int rt_mul(int a, int b) { return (int)((unsigned)a * (unsigned)b); }\n"
+            << "static inline int rt_neg(int a) { return (int)(0u - (unsigned)a); }\n"
+            << "\n"
+            << "static inline void rt_error(int line, int pc, const char *message)\n"
+            << "{\n"
+            << "    fflush(stdout);\n"
+            << "    fprintf(stderr, \"Ошибка: Interpreter Error (Source Line %d, RPN PC %d): %s\\n\", line, pc, message);\n"
+            << "    exit(1);\n"
+            << "}\n"
+            << "\n"
+            << "static inline void rt_index_error(int line, int pc, int index, const char *array, int size, int for_input)\n"
+            << "{\n"
+            << "    char message[256];\n"
+            << "    snprintf(message, sizeof message, \"Array index %d out of bounds for %sarray '%s' (size %d).\",\n"
+            << "             index, for_input ? \"input to \" : \"\", array, size);\n"
+            << "    rt_error(line, pc, message);\n"
+            << "}\n"
+            << "\n"
+            << "static inline int rt_input(int line, int pc)\n"
+            << "{\n"
+            << "    int value, c;\n"
+            << "    int ok;\n"
+            << "    printf(\"Input (integer): \");\n"
+            << "    fflush(stdout);\n"
+            << "    ok = scanf(\"%d\", &value) == 1;\n"
+            << "    while ((c = getchar()) != '\\n' && c != EOF)\n"
+            << "        ;\n"
+            << "    if (!ok)\n"
+            << "        rt_error(line, pc, \"Invalid input, integer expected.\");\n"
+            << "    return value;\n"
+            << "}\n"
+            << "\n"
+            << "/* func: 0 sin, 1 cos, 2 tg, 3 ctg; degrees in, rounded result out */\n"
+            << "static inline int rt_trig(int func, int arg, int line, int pc)\n"
+            << "{\n"
+            << "    double radians = (double)arg * M_PI / 180.0;\n"
+            << "    double result;\n"
+            << "    switch (func)\n"
+            << "    {\n"
+            << "    case 0: result = sin(radians); break;\n"
+            << "    case 1: result = cos(radians); break;\n"
+            << "    case 2: result = tan(radians); break;\n"
+            << "    default:\n"
+            << "    {\n"
+            << "        double tan_val = tan(radians);\n"
+            << "        if (fabs(tan_val) < 1e-15)\n"
+            << "        {\n"
+            << "            char message[128];\n"
+            << "            snprintf(message, sizeof message, \"Cotangent undefined for angle %f degrees (tan = 0)\", (double)arg);\n"
+            << "            rt_error(line, pc, message);\n"
+            << "        }\n"
+            << "        result = 1.0 / tan_val;\n"
+            << "        break;\n"
+            << "    }\n"
+            << "    }\n"
+            << "    return (int)round(result);\n"
+            << "}\n"
+            << "\n";
+
+        for (size_t slot = 0; slot < m_variableNames.size(); ++slot)
+            out << "static int v_" << m_variableNames[slot] << ";\n";
+        for (size_t slot = 0; slot < m_arrayNames.size(); ++slot)
+            out << "static int a_" << m_arrayNames[slot] << "[" << std::max(m_arraySizes[slot], 1) << "];\n";
+        out << "\n"
+            << "int main(void)\n"
+            << "{\n";
+        for (int i = 0; i < layout.max_value_depth; ++i)
+            out << "    int s" << i << " = 0;\n";
+
+        std::vector<int> refs; // Reference stack, resolved at generation time
+        for (size_t i = 0; i < m_rpn.size(); ++i)
+        {
+            const RPNEntry &entry = m_rpn[i];
+            const int d = layout.value_depth[i];
+            const std::string where = std::to_string(entry.line_num) + ", " + std::to_string(i);
+            if (is_target[i])
+                out << "L" << i << ":;\n";
+            if (rpn_is_jump(entry.opcode))
+            {
+                if (entry.operand < 0 || static_cast<size_t>(entry.operand) > m_rpn.size())
+                    throw std::runtime_error("C Emitter Error: Jump from source line " + std::to_string(entry.line_num) +
+                                             " has invalid target " + std::to_string(entry.operand) + ".");
+                if (layout.ref_depth[entry.operand] != 0)
+                    throw std::runtime_error("C Emitter Error: References are live across the jump at RPN PC " + std::to_string(i) + ".");
+            }
+            auto pop_ref = [&refs, &entry]()
+            {
+                if (refs.empty())
+                    throw std::runtime_error("C Emitter Error: Reference stack underflow at source line " + std::to_string(entry.line_num) + ".");
+                int slot = refs.back();
+                refs.pop_back();
+                return slot;
+            };
+
+            // References produce no code of their own
+            if (entry.opcode == RPNOpcode::PUSH_VAR_REF || entry.opcode == RPNOpcode::PUSH_ARRAY)
+            {
+                if (entry.opcode == RPNOpcode::PUSH_VAR_REF)
+                    var(entry.operand);
+                else
+                    array(entry.operand);
+                refs.push_back(entry.operand);
+                continue;
+            }
+
+            out << "    ";
+            switch (entry.opcode)
+            {
+            case RPNOpcode::LOAD_VAR:
+                out << s(d) << " = " << var(entry.operand) << ";";
+                break;
+            case RPNOpcode::PUSH_VAR_REF:
+            case RPNOpcode::PUSH_ARRAY:
+                break;
+            case RPNOpcode::PUSH_CONST:
+                out << s(d) << " = " << literal(entry.operand) << ";";
+                break;
+            case RPNOpcode::ADD:
+                out << s(d - 2) << " = rt_add(" << s(d - 2) << ", " << s(d - 1) << ");";
+                break;
+            case RPNOpcode::SUB:
+                out << s(d - 2) << " = rt_sub(" << s(d - 2) << ", " << s(d - 1) << ");";
+                break;
+            case RPNOpcode::MUL:
+                out << s(d - 2) << " = rt_mul(" << s(d - 2) << ", " << s(d - 1) << ");";
+                break;
+            case RPNOpcode::DIV:
+                out << "if (" << s(d - 1) << " == 0) rt_error(" << where << ", \"Division by zero.\");\n    "
+                    << s(d - 2) << " = " << s(d - 2) << " / " << s(d - 1) << ";";
+                break;
+            case RPNOpcode::CMP_EQ:
+            case RPNOpcode::CMP_GT:
+            case RPNOpcode::CMP_LT:
+            case RPNOpcode::CMP_NE:
+                out << s(d - 2) << " = " << s(d - 2) << " " << comparison(entry.opcode) << " " << s(d - 1) << ";";
+                break;
+            case RPNOpcode::NEG:
+                out << s(d - 1) << " = rt_neg(" << s(d - 1) << ");";
+                break;
+            case RPNOpcode::ASSIGN:
+                out << var(pop_ref()) << " = " << s(d - 1) << ";";
+                break;
+            case RPNOpcode::ARRAY_ASSIGN:
+            case RPNOpcode::ARRAY_ASSIGN_UNCHECKED:
+            {
+                int slot = pop_ref();
+                if (entry.opcode == RPNOpcode::ARRAY_ASSIGN)
+                    out << bounds_check(slot, s(d - 2), where, false);
+                out << array(slot) << "[" << s(d - 2) << "] = " << s(d - 1) << ";";
+                break;
+            }
+            case RPNOpcode::ARRAY_LOAD:
+            case RPNOpcode::ARRAY_LOAD_UNCHECKED:
+            {
+                int slot = pop_ref();
+                if (entry.opcode == RPNOpcode::ARRAY_LOAD)
+                    out << bounds_check(slot, s(d - 1), where, false);
+                out << s(d - 1) << " = " << array(slot) << "[" << s(d - 1) << "];";
+                break;
+            }
+            case RPNOpcode::JUMP:
+                out << "goto L" << entry.operand << ";";
+                break;
+            case RPNOpcode::JUMP_FALSE:
+                out << "if (!" << s(d - 1) << ") goto L" << entry.operand << ";";
+                break;
+            case RPNOpcode::JUMP_FALSE_EQ:
+            case RPNOpcode::JUMP_FALSE_GT:
+            case RPNOpcode::JUMP_FALSE_LT:
+            case RPNOpcode::JUMP_FALSE_NE:
+                out << "if (!(" << s(d - 2) << " " << comparison(entry.opcode) << " " << s(d - 1) << ")) goto L" << entry.operand << ";";
+                break;
+            case RPNOpcode::INPUT:
+                out << var(pop_ref()) << " = rt_input(" << where << ");";
+                break;
+            case RPNOpcode::INPUT_ARRAY:
+            {
+                int slot = pop_ref();
+                out << "{\n    int in = rt_input(" << where << ");\n    " << bounds_check(slot, s(d - 1), where, true)
+                    << array(slot) << "[" << s(d - 1) << "] = in;\n    }";
+                break;
+            }
+            case RPNOpcode::OUTPUT:
+                out << "printf(\"Output: %d\\n\", " << s(d - 1) << ");";
+                break;
+            case RPNOpcode::SIN:
+            case RPNOpcode::COS:
+            case RPNOpcode::TG:
+            case RPNOpcode::CTG:
+            {
+                int func = entry.opcode == RPNOpcode::SIN ? 0 : entry.opcode == RPNOpcode::COS ? 1 : entry.opcode == RPNOpcode::TG ? 2 : 3;
+                out << s(d - 1) << " = rt_trig(" << func << ", " << s(d - 1) << ", " << where << ");";
+                break;
+            }
+            case RPNOpcode::LOAD_ADD_CONST:
+                out << s(d) << " = rt_add(" << var(entry.operand) << ", " << literal(entry.operand2) << ");";
+                break;
+            case RPNOpcode::LOAD_ARRAY_VAR:
+            case RPNOpcode::LOAD_ARRAY_VAR_UNCHECKED:
+                if (entry.opcode == RPNOpcode::LOAD_ARRAY_VAR)
+                    out << bounds_check(entry.operand, var(entry.operand2), where, false);
+                out << s(d) << " = " << array(entry.operand) << "[" << var(entry.operand2) << "];";
+                break;
+            }
+            out << " /* line " << entry.line_num << " */\n";
+        }
+        if (is_target[m_rpn.size()])
+            out << "L" << m_rpn.size() << ":;\n";
+        out << "    return 0;\n"
+            << "}\n";
+        return out.str();
+    }
+
+private:
+    const std::vector<RPNEntry> &m_rpn;
+    std::vector<std::string> m_variableNames;
+    std::vector<std::string> m_arrayNames;
+    std::vector<int> m_arraySizes;
+
+    static std::string s(int depth) { return "s" + std::to_string(depth); }
+
+    // INT_MIN has no literal form in C
+    static std::string literal(int value)
+    {
+        if (value == std::numeric_limits<int>::min())
+            return "(-2147483647 - 1)";
+        return value < 0 ? "(" + std::to_string(value) + ")" : std::to_string(value);
+    }
+
+    static const char *comparison(RPNOpcode op)
+    {
+        switch (op)
+        {
+        case RPNOpcode::CMP_EQ:
+        case RPNOpcode::JUMP_FALSE_EQ:
+            return "==";
+        case RPNOpcode::CMP_GT:
+        case RPNOpcode::JUMP_FALSE_GT:
+            return ">";
+        case RPNOpcode::CMP_LT:
+        case RPNOpcode::JUMP_FALSE_LT:
+            return "<";
+        default:
+            return "!=";
+        }
+    }
+
+    std::string var(int slot) const
+    {
+        if (slot < 0 || static_cast<size_t>(slot) >= m_variableNames.size())
+            throw std::runtime_error("C Emitter Error: Invalid variable slot " + std::to_string(slot) + ".");
+        return "v_" + m_variableNames[slot];
+    }
+
+    std::string array(int slot) const
+    {
+        if (slot < 0 || static_cast<size_t>(slot) >= m_arrayNames.size())
+            throw std::runtime_error("C Emitter Error: Invalid array slot " + std::to_string(slot) + ".");
+        return "a_" + m_arrayNames[slot];
+    }
+
+    std::string bounds_check(int slot, const std::string &index, const std::string &where, bool for_input) const
+    {
+        std::string name = array(slot).substr(2);
+        std::string size = std::to_string(m_arraySizes[slot]);
+        return "if ((unsigned)" + index + " >= " + size + "u) rt_index_error(" + where + ", " + index + ", \"" +
+               name + "\", " + size + ", " + (for_input ? "1" : "0") + ");\n    ";
+    }
+};
+
+// --- Кэш скомпилированной ОПЗ на диске ---
+
+// Файл кэша: заголовок, записи ОПЗ и символы фиксированного размера, затем общая таблица строк.
+// Имя файла - хеш исходника и флаги оптимизаций, так что разные программы не делят файл;
+// в заголовке хеш и размер исходника проверяются ещё раз, а контрольная сумма ловит порчу.
+// Запись переносима только между сборками с одинаковым порядком байт (проверяется через kMagic).
+
+constexpr uint32_t kRPNCacheVersion = 2; // Bump on any change to RPNOpcode, RPNEntry or the layout below
+constexpr int kRPNItemTypeCount = static_cast<int>(RPNItemType::SUPERINSTRUCTION) + 1;
+
+uint64_t fnv1a_64(const void *data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+struct RPNCacheHeader
+{
+    static constexpr uint64_t kMagic = 0x31484341434E5052ull; // "RPNCACH1" when read little-endian
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t source_hash;
+    uint64_t source_size;
+    uint32_t flags; // kRPNCache* bits of the passes that produced the RPN
+    uint32_t opcode_count;
+    uint32_t entry_count;
+    uint32_t symbol_count;
+    uint64_t string_bytes;
+    uint64_t payload_checksum; // fnv1a_64 over everything after the header
+};
+
+struct RPNCacheEntry
+{
+    uint8_t type;
+    uint8_t opcode;
+    uint16_t reserved;
+    int32_t line_num;
+    int32_t operand;
+    int32_t operand2;
+    uint32_t value_offset; // Into the string table
+    uint32_t value_length;
+};
+
+struct RPNCacheSymbol
+{
+    uint8_t s_class;
+    uint8_t is_declared;
+    uint16_t type_token;
+    int32_t size;
+    int32_t declaration_line;
+    int32_t slot;
+    uint32_t name_offset;
+    uint32_t name_length;
+};
+
+static_assert(sizeof(RPNCacheHeader) == 64 && sizeof(RPNCacheEntry) == 24 && sizeof(RPNCacheSymbol) == 24,
+              "RPN cache records must have a fixed layout");
+
+// RPNCacheHeader::flags
+constexpr uint32_t kRPNCacheFolded = 1;
+constexpr uint32_t kRPNCacheFused = 2;
+constexpr uint32_t kRPNCacheBoundsChecked = 4; // eliminate_bounds_checks() ran
+constexpr uint32_t kRPNCacheDeadCode = 8;      // eliminate_dead_code() ran
+
+std::string rpn_cache_path(const std::string &dir, std::string_view source, uint32_t flags)
+{
+    char name[40];
+    std::snprintf(name, sizeof name, "%016llx-%u.rpnc", static_cast<unsigned long long>(fnv1a_64(source.data(), source.size())), flags);
+    if (dir.empty() || dir.back() == '/' || dir.back() == '\\')
+        return dir + name;
+    return dir + "/" + name;
+}
+
+enum class RPNCacheStatus
+{
+    HIT,
+    MISSING, // No file: first run of this source
+    STALE,   // Written by another version or for another source
+    CORRUPT  // Truncated, checksum mismatch or invalid records
+};
+
+// Отображает файл кэша в память и собирает из него ОПЗ и таблицу символов без лексера и парсера.
+// При любой ошибке rpn и symbols не меняются, а why объясняет причину.
+RPNCacheStatus load_rpn_cache(const std::string &path, std::string_view source, uint32_t flags,
+                              std::vector<RPNEntry> &rpn, SymbolTable &symbols, std::string &why)
+{
+    SourceBuffer file;
+    if (!file.mapFile(path))
+        return RPNCacheStatus::MISSING;
+    std::string_view bytes = file.text();
+
+    RPNCacheHeader header;
+    if (bytes.size() < sizeof header)
+    {
+        why = "file is shorter than its header";
+        return RPNCacheStatus::CORRUPT;
+    }
+    std::memcpy(&header, bytes.data(), sizeof header);
+    if (header.magic != RPNCacheHeader::kMagic)
+    {
+        why = "bad magic number";
+        return RPNCacheStatus::CORRUPT;
+    }
+    if (header.version != kRPNCacheVersion || header.header_size != sizeof header || header.opcode_count != static_cast<uint32_t>(kRPNOpcodeCount))
+    {
+        why = "written by another version";
+        return RPNCacheStatus::STALE;
+    }
+    if (header.source_size != source.size() || header.source_hash != fnv1a_64(source.data(), source.size()) || header.flags != flags)
+    {
+        why = "compiled from a different source";
+        return RPNCacheStatus::STALE;
+    }
+    uint64_t expected_size = sizeof header + uint64_t(header.entry_count) * sizeof(RPNCacheEntry) +
+                             uint64_t(header.symbol_count) * sizeof(RPNCacheSymbol) + header.string_bytes;
+    if (bytes.size() != expected_size)
+    {
+        why = "size " + std::to_string(bytes.size()) + " does not match its header (" + std::to_string(expected_size) + ")";
+        return RPNCacheStatus::CORRUPT;
+    }
+    const char *payload = bytes.data() + sizeof header;
+    if (fnv1a_64(payload, bytes.size() - sizeof header) != header.payload_checksum)
+    {
+        why = "checksum mismatch";
+        return RPNCacheStatus::CORRUPT;
+    }
+
+    const char *entries = payload;
+    const char *symbol_records = entries + size_t(header.entry_count) * sizeof(RPNCacheEntry);
+    const char *strings = symbol_records + size_t(header.symbol_count) * sizeof(RPNCacheSymbol);
+    auto string_at = [&](uint32_t offset, uint32_t length, std::string &out)
+    {
+        if (uint64_t(offset) + length > header.string_bytes)
+            return false;
+        out.assign(strings + offset, length);
+        return true;
+    };
+
+    std::vector<RPNEntry> loaded_rpn;
+    loaded_rpn.reserve(header.entry_count);
+    for (uint32_t i = 0; i < header.entry_count; ++i)
+    {
+        RPNCacheEntry record;
+        std::memcpy(&record, entries + size_t(i) * sizeof record, sizeof record);
+        std::string value;
+        if (record.type >= kRPNItemTypeCount || record.opcode >= kRPNOpcodeCount || !string_at(record.value_offset, record.value_length, value))
+        {
+            why = "invalid RPN entry " + std::to_string(i);
+            return RPNCacheStatus::CORRUPT;
+        }
+        RPNOpcode op = static_cast<RPNOpcode>(record.opcode);
+        if (rpn_is_jump(op) && (record.operand < 0 || static_cast<uint32_t>(record.operand) > header.entry_count))
+        {
+            why = "jump target out of range at RPN entry " + std::to_string(i);
+            return RPNCacheStatus::CORRUPT;
+        }
+        loaded_rpn.emplace_back(static_cast<RPNItemType>(record.type), op, std::move(value), record.line_num, record.operand, record.operand2);
+    }
+
+    SymbolTable loaded_symbols;
+    loaded_symbols.reserve(header.symbol_count);
+    for (uint32_t i = 0; i < header.symbol_count; ++i)
+    {
+        RPNCacheSymbol record;
+        std::memcpy(&record, symbol_records + size_t(i) * sizeof record, sizeof record);
+        SymbolInfo info;
+        bool is_array = record.s_class == static_cast<uint8_t>(SymbolClass::INT_ARRAY);
+        if ((!is_array && record.s_class != static_cast<uint8_t>(SymbolClass::INT_VAR)) || record.slot < 0 ||
+            (is_array && record.size <= 0) || !string_at(record.name_offset, record.name_length, info.name))
+        {
+            why = "invalid symbol " + std::to_string(i);
+            return RPNCacheStatus::CORRUPT;
+        }
+        info.s_class = static_cast<SymbolClass>(record.s_class);
+        info.type_token = is_array ? IMAS_TOK : INT_TOK;
+        info.size = record.size;
+        info.declaration_line = record.declaration_line;
+        info.is_declared = record.is_declared != 0;
+        info.slot = record.slot;
+        loaded_symbols.push_back(std::move(info));
+    }
+
+    rpn = std::move(loaded_rpn);
+    symbols = std::move(loaded_symbols);
+    return RPNCacheStatus::HIT;
+}
+
+// Пишет во временный файл и переименовывает его, чтобы параллельные запуски не видели недописанный кэш.
+// Кэш - только ускорение: при ошибке записи возвращается false, а программа работает дальше.
+bool save_rpn_cache(const std::string &path, std::string_view source, uint32_t flags,
+                    const std::vector<RPNEntry> &rpn, const SymbolTable &symbols)
+{
+    std::string strings;
+    std::string payload;
+    payload.reserve(rpn.size() * sizeof(RPNCacheEntry) + symbols.size() * sizeof(RPNCacheSymbol));
+    auto add_string = [&strings](const std::string &text, uint32_t &offset, uint32_t &length)
+    {
+        offset = static_cast<uint32_t>(strings.size());
+        length = static_cast<uint32_t>(text.size());
+        strings += text;
+    };
+    for (const RPNEntry &entry : rpn)
+    {
+        RPNCacheEntry record{};
+        record.type = static_cast<uint8_t>(entry.type);
+        record.opcode = static_cast<uint8_t>(entry.opcode);
+        record.line_num = entry.line_num;
+        record.operand = entry.operand;
+        record.operand2 = entry.operand2;
+        add_string(entry.value, record.value_offset, record.value_length);
+        payload.append(reinterpret_cast<const char *>(&record), sizeof record);
+    }
+    for (const SymbolInfo &info : symbols)
+    {
+        RPNCacheSymbol record{};
+        record.s_class = static_cast<uint8_t>(info.s_class);
+        record.is_declared = info.is_declared ? 1 : 0;
+        record.type_token = static_cast<uint16_t>(info.type_token);
+        record.size = info.size;
+        record.declaration_line = info.declaration_line;
+        record.slot = info.slot;
+        add_string(info.name, record.name_offset, record.name_length);
+        payload.append(reinterpret_cast<const char *>(&record), sizeof record);
+    }
+    payload += strings;
+    if (strings.size() > std::numeric_limits<uint32_t>::max())
+        return false;
+
+    RPNCacheHeader header{};
+    header.magic = RPNCacheHeader::kMagic;
+    header.version = kRPNCacheVersion;
+    header.header_size = sizeof header;
+    header.source_hash = fnv1a_64(source.data(), source.size());
+    header.source_size = source.size();
+    header.flags = flags;
+    header.opcode_count = kRPNOpcodeCount;
+    header.entry_count = static_cast<uint32_t>(rpn.size());
+    header.symbol_count = static_cast<uint32_t>(symbols.size());
+    header.string_bytes = strings.size();
+    header.payload_checksum = fnv1a_64(payload.data(), payload.size());
+
+#ifdef _WIN32
+    CreateDirectoryA(path.substr(0, path.find_last_of("/\\") + 1).c_str(), nullptr);
+    const std::string temp_path = path + "." + std::to_string(GetCurrentProcessId()) + ".tmp";
+#else
+    mkdir(path.substr(0, path.find_last_of('/') + 1).c_str(), 0777);
+    const std::string temp_path = path + "." + std::to_string(getpid()) + ".tmp";
+#endif
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        if (!out.write(reinterpret_cast<const char *>(&header), sizeof header) || !out.write(payload.data(), static_cast<std::streamsize>(payload.size())))
+        {
+            out.close();
+            std::remove(temp_path.c_str());
+            return false;
+        }
+    }
+#ifdef _WIN32
+    if (!MoveFileExA(temp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+#else
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0)
+#endif
+    {
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// --- Вспомогательные функции для main ---
+std::string symbolTypeToString(TokenCode tc)
+{
+    Token temp(tc);
+    return temp.codeToString();
+}
+std::string symbolClassToString(SymbolClass sc)
+{
+    switch (sc)
+    {
+    case SymbolClass::INT_VAR:
+        return "INT_VARIABLE";
+    case SymbolClass::INT_ARRAY:
+        return "INT_ARRAY";
+    case SymbolClass::UNKNOWN:
+        return "UNKNOWN_CLASS";
+    default:
+        return "INVALID_CLASS_CODE(" + std::to_string(static_cast<int>(sc)) + ")";
+    }
+}
+
+// Параметры командной строки
+enum class ExecutionBackend
+{
+    STACK,    // RPNInterpreter over the RPN
+    REGISTER, // RegisterVM over three-address code lowered from the RPN
+    JIT       // Native x86-64 code generated by RPNJit
+};
+
+enum class ExecutionEngine
+{
+    SWITCH,  // RPNInterpreter::run()
+    THREADED // RPNInterpreter::run_threaded()
+};
+
+enum class HeadlessPhase
+{
+    LEX,      // Only tokenize the source
+    COMPILE,  // Parse, optimize and prepare the selected backend, but do not run
+    RUN,      // Compile and run the program
+    DUMP_RPN  // Compile and print the optimized RPN
+};
+
+struct CommandLineOptions
+{
+    std::string source_path;                            // Positional SOURCE: run headless instead of prompting
+    HeadlessPhase phase = HeadlessPhase::RUN;           // --phase=lex|compile|run|dump-rpn (headless only)
+    std::string cache_dir;                              // --cache-dir=DIR: reuse compiled RPN across runs (headless only)
+    bool batch = false;                                 // --batch: no prompts, program input read from stdin, buffered output
+
+    ExecutionEngine engine = ExecutionEngine::SWITCH;   // --engine=switch|threaded
+    ExecutionBackend backend = ExecutionBackend::STACK; // --backend=stack|register|jit
+    bool fold = true;                                   // --no-fold disables fold_constants()
+    bool dce = true;                                    // --no-dce disables eliminate_dead_code()
+    bool bce = true;                                    // --no-bce disables eliminate_bounds_checks()
+    bool fuse = true;                                   // --no-fuse disables fuse_superinstructions()
+
+    std::string emit_c_path;                            // --emit-c=PATH: write the program as C instead of running it
+    bool count_allocations = false;                     // --count-allocs: report heap allocations made inside RPNInterpreter::run()
+    bool profile = false;                               // --profile: hot-spot report after the run (stack backend)
+    std::string profile_json_path;                      // --profile-json=PATH: the same profile as JSON
+    bool bench = false;                                 // --bench: time lexing, parsing and run() on generated programs
+    int bench_scale = 1;                                // --bench-scale=N: multiply workload sizes
+    std::string bench_json_path;                        // --bench-json=PATH: also write the results as JSON
+    bool bench_c = false;                               // --bench-c: build the emitted C and time it against run()
+    bool bench_trig = false;                            // --bench-trig: compare trig tables with libm and exit
+    int stress_parse_statements = 0;                    // --stress-parse=N: parse a generated N-statement program and exit
+
+    bool profiling() const { return profile || !profile_json_path.empty(); }
+};
+
+CommandLineOptions parse_command_line(int argc, char *argv[])
+{
+    CommandLineOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--count-allocs")
+            options.count_allocations = true;
+        else if (arg == "--engine=switch")
+            options.engine = ExecutionEngine::SWITCH;
+        else if (arg == "--engine=threaded")
+            options.engine = ExecutionEngine::THREADED;
+        else if (arg == "--no-fold")
+            options.fold = false;
+        else if (arg == "--no-dce")
+            options.dce = false;
+        else if (arg == "--no-bce")
+            options.bce = false;
+        else if (arg == "--no-fuse")
+            options.fuse = false;
+        else if (arg == "--backend=stack")
+            options.backend = ExecutionBackend::STACK;
+        else if (arg == "--backend=register")
+            options.backend = ExecutionBackend::REGISTER;
+        else if (arg == "--backend=jit")
+            options.backend = ExecutionBackend::JIT;
+        else if (arg.compare(0, 9, "--emit-c=") == 0 && arg.size() > 9)
+            options.emit_c_path = arg.substr(9);
+        else if (arg == "--bench-c")
+            options.bench_c = true;
+        else if (arg == "--bench-trig")
+            options.bench_trig = true;
+        else if (arg == "--batch")
+            options.batch = true;
+        else if (arg == "--phase=lex")
+            options.phase = HeadlessPhase::LEX;
+        else if (arg == "--phase=compile")
+            options.phase = HeadlessPhase::COMPILE;
+        else if (arg == "--phase=run")
+            options.phase = HeadlessPhase::RUN;
+        else if (arg == "--phase=dump-rpn")
+            options.phase = HeadlessPhase::DUMP_RPN;
+        else if (arg.compare(0, 12, "--cache-dir=") == 0 && arg.size() > 12)
+            options.cache_dir = arg.substr(12);
+        else if (arg == "--profile")
+            options.profile = true;
+        else if (arg == "--bench")
+            options.bench = true;
+        else if (arg.compare(0, 14, "--bench-scale=") == 0 && arg.size() > 14)
+        {
+            try
+            {
+                options.bench_scale = std::stoi(arg.substr(14));
+            }
+            catch (const std::exception &)
+            {
+                throw std::runtime_error("Invalid scale in '" + arg + "'.");
+            }
+            if (options.bench_scale <= 0 || options.bench_scale > 1000)
+                throw std::runtime_error("Benchmark scale must be between 1 and 1000 in '" + arg + "'.");
+        }
+        else if (arg.compare(0, 13, "--bench-json=") == 0 && arg.size() > 13)
+        {
+            options.bench = true;
+            options.bench_json_path = arg.substr(13);
+        }
+        else if (arg.compare(0, 15, "--profile-json=") == 0 && arg.size() > 15)
+            options.profile_json_path = arg.substr(15);
+        else if (arg.compare(0, 15, "--stress-parse=") == 0 && arg.size() > 15)
+        {
+            try
+            {
+                options.stress_parse_statements = std::stoi(arg.substr(15));
+            }
+            catch (const std::exception &)
+            {
+                throw std::runtime_error("Invalid statement count in '" + arg + "'.");
+            }
+            if (options.stress_parse_statements <= 0)
+                throw std::runtime_error("Statement count must be positive in '" + arg + "'.");
+        }
+        else if (arg.compare(0, 1, "-") != 0)
+        {
+            if (!options.source_path.empty())
+                throw std::runtime_error("More than one source file given: '" + options.source_path + "' and '" + arg + "'.");
+            options.source_path = arg;
+        }
+        else
+            throw std::runtime_error("Unknown command line option '" + arg + "'.");
+    }
+    if (options.phase != HeadlessPhase::RUN && options.source_path.empty())
+        throw std::runtime_error("--phase requires a source file argument.");
+    if (!options.cache_dir.empty() && options.source_path.empty())
+        throw std::runtime_error("--cache-dir requires a source file argument.");
+    if (options.profiling() && (options.backend != ExecutionBackend::STACK || options.engine != ExecutionEngine::SWITCH))
+        throw std::runtime_error("Profiling is only available for --backend=stack --engine=switch.");
+    if (options.profiling() && options.count_allocations)
+        throw std::runtime_error("--count-allocs cannot be combined with profiling.");
+    return options;
+}
+
+// RPNCacheHeader::flags for the passes enabled by options; run_rpn_passes() runs exactly these
+uint32_t rpn_pass_flags(const CommandLineOptions &options)
+{
+    return (options.fold ? kRPNCacheFolded : 0) | (options.dce ? kRPNCacheDeadCode : 0) |
+           (options.bce ? kRPNCacheBoundsChecked : 0) | (options.fuse ? kRPNCacheFused : 0);
+}
+
+// Оптимизация ОПЗ: все режимы запускают проходы в одном порядке - свёртка констант, мёртвый код,
+// проверки границ, суперинструкции. Если задан report_out, после каждого прохода печатается его отчёт.
+void run_rpn_passes(std::vector<RPNEntry> &rpn, const SymbolTable &symbols, const CommandLineOptions &options,
+                    std::ostream *report_out = nullptr)
+{
+    const uint32_t passes = rpn_pass_flags(options);
+    if (passes & kRPNCacheFolded)
+    {
+        RPNFoldingReport report = fold_constants(rpn);
+        if (report_out)
+        {
+            std::ostream &out = *report_out;
+            out << "--- Свёртка констант ---" << std::endl;
+            out << "  folded operations: " << report.folded << std::endl;
+            out << "  simplified identities: " << report.identities << std::endl;
+            out << "  RPN entries: " << report.entries_before << " -> " << report.entries_after
+                << " (-" << (report.entries_before - report.entries_after) << ")" << std::endl;
+            out << "--- Конец отчёта ---\n"
+                << std::endl;
+        }
+    }
+
+    if (passes & kRPNCacheDeadCode)
+    {
+        RPNDeadCodeReport report = eliminate_dead_code(rpn);
+        if (report_out)
+        {
+            std::ostream &out = *report_out;
+            out << "--- Удаление мёртвого кода ---" << std::endl;
+            out << "  constant branches: " << report.folded_branches << std::endl;
+            out << "  unreachable blocks: " << report.unreachable_blocks << std::endl;
+            out << "  redundant jumps: " << report.redundant_jumps << std::endl;
+            out << "  dead stores: " << report.dead_stores << std::endl;
+            out << "  RPN entries: " << report.entries_before << " -> " << report.entries_after
+                << " (-" << (report.entries_before - report.entries_after) << ")" << std::endl;
+            out << "--- Конец отчёта ---\n"
+                << std::endl;
+        }
+    }
+
+    if (passes & kRPNCacheBoundsChecked)
+    {
+        RPNBoundsReport report = eliminate_bounds_checks(rpn, symbols);
+        if (report_out)
+            print_bounds_report(*report_out, report);
+    }
+
+    if (passes & kRPNCacheFused)
+    {
+        RPNFusionReport report = fuse_superinstructions(rpn);
+        if (report_out)
+        {
+            std::ostream &out = *report_out;
+            out << "--- Суперинструкции ---" << std::endl;
+            out << "  load-add-const: " << report.load_add_const << std::endl;
+            out << "  compare-and-branch: " << report.compare_and_branch << std::endl;
+            out << "  indexed-load-by-variable: " << report.indexed_load_by_var << std::endl;
+            out << "  RPN entries: " << report.entries_before << " -> " << report.entries_after
+                << " (-" << (report.entries_before - report.entries_after) << ")" << std::endl;
+            out << "--- Конец отчёта ---\n"
+                << std::endl;
+        }
+    }
+}
+
+// Discards everything written to it; keeps interpreter output out of benchmark timings
+class NullStreamBuffer : public std::streambuf
+{
+protected:
+    int overflow(int c) override { return c; }
+};
+
+void write_c_source(const std::string &path, const std::string &code)
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out || !(out << code))
+        throw std::runtime_error("Cannot write C source to '" + path + "'.");
+}
+
+// Builds the emitted C with the host compiler ($CC, default cc) and times the executable against
+// RPNInterpreter::run(). Output of both is discarded; the native time includes process start-up.
+// Programs that read input should not be benchmarked this way.
+void run_c_benchmark(const std::vector<RPNEntry> &rpn, const SymbolTable &symbolTable, const std::string &source_name)
+{
+#ifdef _WIN32
+    const std::string exe_path = "rpn_bench.exe", null_device = "NUL";
+#else
+    const std::string exe_path = "./rpn_bench", null_device = "/dev/null";
+#endif
+    const std::string c_path = "rpn_bench.c";
+    const char *cc = std::getenv("CC");
+    const std::string compiler = (cc && *cc) ? cc : "cc";
+
+    RPNCEmitter emitter(rpn, symbolTable);
+    write_c_source(c_path, emitter.emit(source_name));
+    const std::string build_command = compiler + " -O2 " + c_path + " -o " + exe_path + " -lm";
+    std::cout << "Building: " << build_command << std::endl;
+    if (std::system(build_command.c_str()) != 0)
+        throw std::runtime_error("C compilation failed: " + build_command);
+
+    RPNInterpreter interpreter(rpn, symbolTable);
+    NullStreamBuffer null_buffer;
+    std::streambuf *saved = std::cout.rdbuf(&null_buffer);
+    auto interp_start = std::chrono::steady_clock::now();
+    try
     {
-        std::cout << "  Interpreter Operand Stack (PC " << m_pc << "): [";
-        for (size_t i = 0; i < m_operandStack.size(); ++i)
+        interpreter.run();
+    }
+    catch (...)
+    {
+        g_batchIO.flush();
+        std::cout.rdbuf(saved);
+        throw;
+    }
+    auto interp_end = std::chrono::steady_clock::now();
+    g_batchIO.flush(); // Buffered batch output belongs to the discarded run
+    std::cout.rdbuf(saved);
+
+    auto native_start = std::chrono::steady_clock::now();
+    int native_status = std::system((exe_path + " > " + null_device).c_str());
+    auto native_end = std::chrono::steady_clock::now();
+    if (native_status != 0)
+        throw std::runtime_error("Compiled program exited with status " + std::to_string(native_status) + ".");
+
+    double interp_seconds = std::chrono::duration<double>(interp_end - interp_start).count();
+    double native_seconds = std::chrono::duration<double>(native_end - native_start).count();
+    std::cout << "--- Бенчмарк: интерпретатор против C ---" << std::endl;
+    std::cout << "  RPNInterpreter::run(): " << interp_seconds << " s" << std::endl;
+    std::cout << "  " << exe_path << ": " << native_seconds << " s" << std::endl;
+    if (native_seconds > 0)
+        std::cout << "  Speedup: " << interp_seconds / native_seconds << "x" << std::endl;
+    std::cout << "--- Конец бенчмарка ---" << std::endl;
+}
+
+// Генерирует программу из flat_statements операторов внутри nesting вложенных блоков if/while
+std::string generate_stress_program(int flat_statements, int nesting)
+{
+    std::string code = "int i;\nint s;\narr a[16];\nbegin\n";
+    for (int d = 0; d < nesting; ++d)
+        code += (d % 2 == 0) ? "if (i < 1) begin\n" : "while (i < 1) begin\n";
+    for (int k = 0; k < flat_statements; ++k)
+    {
+        switch (k % 4)
         {
-            if (std::holds_alternative<int>(m_operandStack[i]))
-            {
-                std::cout << std::get<int>(m_operandStack[i]);
-            }
-            else
-            {
-                std::cout << "\"" << std::get<std::string>(m_operandStack[i]) << "\"";
-            }
-            if (i < m_operandStack.size() - 1)
-                std::cout << ", ";
+        case 0:
+            code += "s = s + i * 3 - (s / 7);\n";
+            break;
+        case 1:
+            code += "a[i] = -s + sin(i);\n";
+            break;
+        case 2:
+            code += "if (s > 100) begin s = s - 100; end else begin i = i + 1; end;\n";
+            break;
+        default:
+            code += "cout(a[i]);\n";
+            break;
         }
-        std::cout << "]" << std::endl;
     }
+    for (int d = 0; d < nesting; ++d)
+        code += (d % 2 == 0) ? "i = 1; end;\n" : "end;\n"; // Closes blocks innermost first
+    code += "end\n";
+    return code;
+}
+
+struct StressParseJob
+{
+    std::string_view source;
+    size_t rpn_entries = 0;
+    size_t token_count = 0;
+    std::string error;
 };
 
-// --- Вспомогательные функции для main ---
-std::string symbolTypeToString(TokenCode tc)
+void run_stress_parse_job(StressParseJob &job)
 {
-    Token temp(tc, "");
-    return temp.codeToString();
+    try
+    {
+        FrontEndArena arena;
+        StringInterner lexemes(arena);
+        Lexer lexer(job.source, lexemes);
+        TokenStream tokens(lexer, lexemes);
+        RPNGenerator rpnGen(tokens);
+        job.rpn_entries = rpnGen.generate().size();
+        job.token_count = tokens.count();
+    }
+    catch (const std::exception &e)
+    {
+        job.error = e.what();
+    }
 }
-std::string symbolClassToString(SymbolClass sc)
+
+#ifdef _WIN32
+DWORD WINAPI stress_parse_thread(LPVOID arg)
 {
-    switch (sc)
+    run_stress_parse_job(*static_cast<StressParseJob *>(arg));
+    return 0;
+}
+#else
+void *stress_parse_thread(void *arg)
+{
+    run_stress_parse_job(*static_cast<StressParseJob *>(arg));
+    return nullptr;
+}
+#endif
+
+// Разбирает сгенерированную программу из statements операторов в потоке с фиксированным стеком:
+// если разбор операторов снова станет рекурсивным, тест упадёт по переполнению стека.
+bool run_stress_parse(int statements)
+{
+    const size_t stack_bytes = 256 * 1024;
+    const int nesting = std::min(statements / 2, 10000);
+    std::string code = generate_stress_program(statements - nesting, nesting);
+
+    StressParseJob job;
+    job.source = code;
+    auto start = std::chrono::steady_clock::now();
+#ifdef _WIN32
+    HANDLE thread = CreateThread(nullptr, stack_bytes, stress_parse_thread, &job, STACK_SIZE_PARAM_IS_A_RESERVATION, nullptr);
+    if (!thread)
+        throw std::runtime_error("Cannot start the stress-parse thread.");
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, stack_bytes);
+    pthread_t thread;
+    int status = pthread_create(&thread, &attr, stress_parse_thread, &job);
+    pthread_attr_destroy(&attr);
+    if (status != 0)
+        throw std::runtime_error("Cannot start the stress-parse thread.");
+    pthread_join(thread, nullptr);
+#endif
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "--- Стресс-тест парсера ---" << std::endl;
+    std::cout << "  statements: " << statements << " (nesting depth " << nesting << ")" << std::endl;
+    std::cout << "  source bytes: " << code.size() << std::endl;
+    std::cout << "  parser stack: " << stack_bytes / 1024 << " KiB" << std::endl;
+    if (!job.error.empty())
     {
-    case SymbolClass::INT_VAR:
-        return "INT_VARIABLE";
-    case SymbolClass::INT_ARRAY:
-        return "INT_ARRAY";
-    case SymbolClass::UNKNOWN:
-        return "UNKNOWN_CLASS";
-    default:
-        return "INVALID_CLASS_CODE(" + std::to_string(static_cast<int>(sc)) + ")";
+        std::cout << "  FAILED: " << job.error << std::endl;
+        std::cout << "--- Конец стресс-теста ---" << std::endl;
+        return false;
+    }
+    std::cout << "  tokens: " << job.token_count << std::endl;
+    std::cout << "  RPN entries: " << job.rpn_entries << std::endl;
+    std::cout << "  time: " << seconds << " s" << std::endl;
+    std::cout << "--- Конец стресс-теста ---" << std::endl;
+    return true;
+}
+
+// --- Бенчмарк конвейера на сгенерированных программах (--bench) ---
+
+struct BenchWorkload
+{
+    std::string name;
+    std::string source;
+};
+
+std::string bench_expression_tree(int depth, int &leaf)
+{
+    static const char *const leaves[] = {"i", "3", "j", "7", "i", "1"};
+    static const char *const ops[] = {" + ", " - ", " + ", " - "};
+    if (depth == 0)
+        return leaves[leaf++ % 6];
+    std::string left = bench_expression_tree(depth - 1, leaf);
+    std::string right = bench_expression_tree(depth - 1, leaf);
+    return "(" + left + ops[depth % 4] + right + ")";
+}
+
+// Размеры подобраны так, чтобы при scale = 1 каждый этап занимал миллисекунды, а не микросекунды
+std::vector<BenchWorkload> generate_bench_workloads(int scale)
+{
+    std::vector<BenchWorkload> workloads;
+
+    workloads.push_back({"nested_loops",
+                         "int i;\nint j;\nint s;\nbegin\n"
+                         "  i = 0;\n  s = 0;\n"
+                         "  while (i < " + std::to_string(1000 * scale) + ") begin\n"
+                         "    j = 0;\n"
+                         "    while (j < 1000) begin\n"
+                         "      s = s + i - j;\n"
+                         "      j = j + 1;\n"
+                         "    end;\n"
+                         "    s = s / 2;\n"
+                         "    i = i + 1;\n"
+                         "  end;\n"
+                         "  cout(s);\nend\n"});
+
+    const std::string size = std::to_string(100000 * scale);
+    workloads.push_back({"array_rw",
+                         "int i;\nint k;\narr a[" + size + "];\nbegin\n"
+                         "  k = 0;\n"
+                         "  while (k < 10) begin\n"
+                         "    i = 0;\n"
+                         "    while (i < " + size + ") begin a[i] = i - k; i = i + 1; end;\n"
+                         "    i = 1;\n"
+                         "    while (i < " + size + ") begin a[i] = a[i] + a[i - 1] / 2; i = i + 1; end;\n"
+                         "    k = k + 1;\n"
+                         "  end;\n"
+                         "  cout(a[" + size + " - 1]);\nend\n"});
+
+    int leaf = 0;
+    workloads.push_back({"deep_expressions",
+                         "int i;\nint j;\nint s;\nbegin\n"
+                         "  i = 0;\n  j = 5;\n"
+                         "  while (i < " + std::to_string(10000 * scale) + ") begin\n"
+                         "    s = " + bench_expression_tree(9, leaf) + ";\n"
+                         "    i = i + 1;\n"
+                         "  end;\n"
+                         "  cout(s);\nend\n"});
+
+    workloads.push_back({"trig_loop",
+                         "int i;\nint a;\nint t;\nint s;\nbegin\n"
+                         "  i = 0;\n  a = -700;\n  t = -60;\n  s = 0;\n"
+                         "  while (i < " + std::to_string(200000 * scale) + ") begin\n"
+                         "    s = s + sin(a) - cos(a * 2) + tg(t);\n"
+                         "    a = a + 7;\n"
+                         "    if (a > 700) begin a = -700; end;\n"
+                         "    t = t + 1;\n"
+                         "    if (t > 60) begin t = -60; end;\n"
+                         "    i = i + 1;\n"
+                         "  end;\n"
+                         "  cout(s);\nend\n"});
+
+    std::string straight = "int x;\nint y;\nint z;\narr b[16];\nbegin\n";
+    const int statements = 50000 * scale;
+    for (int k = 0; k < statements; ++k)
+    {
+        switch (k % 4)
+        {
+        case 0:
+            straight += "  x = x + 3;\n";
+            break;
+        case 1:
+            straight += "  y = y - x / 7;\n";
+            break;
+        case 2:
+            straight += "  z = y / 3 - x;\n";
+            break;
+        default:
+            straight += "  b[" + std::to_string(k % 16) + "] = z - (x + " + std::to_string(k % 97) + ");\n";
+            break;
+        }
+    }
+    straight += "  cout(z);\nend\n";
+    workloads.push_back({"straight_line", std::move(straight)});
+    return workloads;
+}
+
+struct BenchResult
+{
+    std::string name;
+    size_t source_bytes = 0;
+    size_t source_lines = 0;
+    size_t tokens = 0;
+    double lex_seconds = 0;
+    size_t rpn_entries = 0; // Straight from generate(), before fold/fuse
+    double generate_seconds = 0;
+    size_t executed_rpn_entries = 0; // After the enabled optimizations; what run() executes
+    uint64_t instructions_executed = 0;
+    double run_seconds = 0;
+    unsigned long long front_end_allocations = 0; // Heap allocations made by one generate(), lexing included
+};
+
+// Лучшее из repetitions измерений каждого этапа. generate() тянет токены сам, поэтому его время
+// включает лексический анализ; время run() не включает подготовку интерпретатора.
+BenchResult run_bench_workload(const BenchWorkload &workload, const CommandLineOptions &options, int repetitions)
+{
+    BenchResult result;
+    result.name = workload.name;
+    result.source_bytes = workload.source.size();
+    result.source_lines = static_cast<size_t>(std::count(workload.source.begin(), workload.source.end(), '\n'));
+    result.lex_seconds = result.generate_seconds = result.run_seconds = std::numeric_limits<double>::max();
+    auto elapsed_since = [](std::chrono::steady_clock::time_point start)
+    { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+
+    for (int r = 0; r < repetitions; ++r)
+    {
+        FrontEndArena arena;
+        StringInterner lexemes(arena);
+        Lexer lexer(workload.source, lexemes);
+        TokenStream tokens(lexer, lexemes);
+        auto start = std::chrono::steady_clock::now();
+        while (tokens.next().code != EOF_TOK)
+        {
+        }
+        result.lex_seconds = std::min(result.lex_seconds, elapsed_since(start));
+        result.tokens = tokens.count();
+    }
+
+    std::vector<RPNEntry> rpn;
+    SymbolTable symbolTable;
+    for (int r = 0; r < repetitions; ++r)
+    {
+        FrontEndArena arena;
+        StringInterner lexemes(arena);
+        Lexer lexer(workload.source, lexemes);
+        TokenStream tokens(lexer, lexemes);
+        RPNGenerator rpnGen(tokens);
+        unsigned long long allocations_before = g_heapAllocations;
+        auto start = std::chrono::steady_clock::now();
+        rpn = rpnGen.generate();
+        result.generate_seconds = std::min(result.generate_seconds, elapsed_since(start));
+        result.front_end_allocations = g_heapAllocations - allocations_before;
+        symbolTable = rpnGen.takeSymbolTable();
+    }
+    result.rpn_entries = rpn.size();
+    run_rpn_passes(rpn, symbolTable, options);
+    result.executed_rpn_entries = rpn.size();
+
+    NullStreamBuffer null_buffer;
+    std::streambuf *saved = std::cout.rdbuf(&null_buffer);
+    try
+    {
+        RPNInterpreter interpreter(rpn, symbolTable);
+        RPNProfile profile; // One profiled pass only counts instructions; timed runs are unprofiled
+        interpreter.run_profiled(profile);
+        for (uint64_t count : profile.counts)
+            result.instructions_executed += count;
+        for (int r = 0; r < repetitions; ++r)
+        {
+            auto start = std::chrono::steady_clock::now();
+            if (options.engine == ExecutionEngine::THREADED)
+                interpreter.run_threaded();
+            else
+                interpreter.run();
+            result.run_seconds = std::min(result.run_seconds, elapsed_since(start));
+        }
+    }
+    catch (...)
+    {
+        std::cout.rdbuf(saved);
+        throw;
+    }
+    std::cout.rdbuf(saved);
+    return result;
+}
+
+void write_bench_json(std::ostream &out, const std::vector<BenchResult> &results, const CommandLineOptions &options, int repetitions)
+{
+    auto rate = [](double amount, double seconds)
+    { return seconds > 0 ? amount / seconds : 0.0; };
+    out << "{\n";
+    out << "  \"scale\": " << options.bench_scale << ",\n";
+    out << "  \"repetitions\": " << repetitions << ",\n";
+    out << "  \"engine\": \"" << (options.engine == ExecutionEngine::THREADED ? "threaded" : "switch") << "\",\n";
+    out << "  \"fold\": " << (options.fold ? "true" : "false") << ",\n";
+    out << "  \"fuse\": " << (options.fuse ? "true" : "false") << ",\n";
+    out << "  \"workloads\": [";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchResult &r = results[i];
+        out << (i ? ",\n" : "\n") << "    {\"name\": \"" << json_escape(r.name) << "\""
+            << ", \"source_bytes\": " << r.source_bytes
+            << ", \"source_lines\": " << r.source_lines
+            << ", \"tokens\": " << r.tokens
+            << ", \"lex_seconds\": " << r.lex_seconds
+            << ", \"tokens_per_second\": " << rate(static_cast<double>(r.tokens), r.lex_seconds)
+            << ", \"rpn_entries\": " << r.rpn_entries
+            << ", \"generate_seconds\": " << r.generate_seconds
+            << ", \"rpn_entries_per_second\": " << rate(static_cast<double>(r.rpn_entries), r.generate_seconds)
+            << ", \"front_end_allocations\": " << r.front_end_allocations
+            << ", \"executed_rpn_entries\": " << r.executed_rpn_entries
+            << ", \"instructions_executed\": " << r.instructions_executed
+            << ", \"run_seconds\": " << r.run_seconds
+            << ", \"instructions_per_second\": " << rate(static_cast<double>(r.instructions_executed), r.run_seconds) << "}";
+    }
+    out << (results.empty() ? "]\n" : "\n  ]\n") << "}\n";
+}
+
+void run_benchmark_suite(const CommandLineOptions &options)
+{
+    const int repetitions = 5;
+    std::vector<BenchResult> results;
+    std::cout << "--- Бенчмарк конвейера (scale " << options.bench_scale << ", лучшее из " << repetitions << ") ---" << std::endl;
+    for (const BenchWorkload &workload : generate_bench_workloads(options.bench_scale))
+    {
+        BenchResult r = run_bench_workload(workload, options, repetitions);
+        std::cout << "  " << r.name << ": " << r.source_bytes << " bytes, " << r.source_lines << " lines\n"
+                  << "    lex:      " << r.tokens << " tokens in " << r.lex_seconds * 1e3 << " ms ("
+                  << (r.lex_seconds > 0 ? r.tokens / r.lex_seconds / 1e6 : 0.0) << " M tokens/s)\n"
+                  << "    generate: " << r.rpn_entries << " RPN entries in " << r.generate_seconds * 1e3 << " ms ("
+                  << (r.generate_seconds > 0 ? r.rpn_entries / r.generate_seconds / 1e6 : 0.0) << " M entries/s, includes lexing)\n"
+                  << "              " << r.front_end_allocations << " heap allocations ("
+                  << (r.source_lines ? static_cast<double>(r.front_end_allocations) / r.source_lines : 0.0) << " per source line)\n"
+                  << "    run:      " << r.instructions_executed << " instructions in " << r.run_seconds * 1e3 << " ms ("
+                  << (r.run_seconds > 0 ? r.instructions_executed / r.run_seconds / 1e6 : 0.0) << " M instructions/s)" << std::endl;
+        results.push_back(std::move(r));
+    }
+    std::cout << "--- Конец бенчмарка ---" << std::endl;
+
+    if (!options.bench_json_path.empty())
+    {
+        std::ofstream json(options.bench_json_path);
+        if (json)
+            write_bench_json(json, results, options, repetitions);
+        if (!json)
+            throw std::runtime_error("Cannot write benchmark results to '" + options.bench_json_path + "'.");
+        std::cout << "Results written to " << options.bench_json_path << std::endl;
+    }
+}
+
+void report_profile(const CommandLineOptions &options, std::ostream &out, const RPNProfile &profile, const std::vector<RPNEntry> &rpn)
+{
+    if (options.profile)
+        print_profile_report(out, profile, rpn);
+    if (!options.profile_json_path.empty())
+    {
+        std::ofstream json(options.profile_json_path);
+        if (json)
+            write_profile_json(json, profile, rpn);
+        if (!json)
+            throw std::runtime_error("Cannot write profile to '" + options.profile_json_path + "'.");
+    }
+}
+
+// Stack backend with the engine from the command line. With --profile/--profile-json the program runs
+// under run_profiled() and the profile is reported to report_out even if the program stops with an error.
+void run_stack_interpreter(RPNInterpreter &interpreter, const std::vector<RPNEntry> &rpn, const CommandLineOptions &options, std::ostream &report_out)
+{
+    if (!options.profiling())
+    {
+        if (options.engine == ExecutionEngine::THREADED)
+            interpreter.run_threaded();
+        else
+            interpreter.run();
+        return;
+    }
+    RPNProfile profile;
+    try
+    {
+        interpreter.run_profiled(profile);
+    }
+    catch (const std::runtime_error &)
+    {
+        g_batchIO.flush();
+        report_profile(options, report_out, profile, rpn);
+        throw;
+    }
+    g_batchIO.flush();
+    report_profile(options, report_out, profile, rpn);
+}
+
+void print_rpn(std::ostream &out, const std::vector<RPNEntry> &rpn)
+{
+    out << "--- ОПЗ (RPN) ---\n";
+    if (rpn.empty())
+        out << "  (пусто)\n";
+    int rpn_idx = 0;
+    for (const auto &entry : rpn)
+    {
+        out << "  " << rpn_idx++ << ": Line " << entry.line_num << ": " << entry.typeToString()
+            << " Value: \"" << entry.displayValue() << "\"\n";
+    }
+    out << "--- Конец ОПЗ ---\n"
+        << std::endl;
+}
+
+// Неинтерактивный запуск: путь к исходнику задан в командной строке, stdin - ввод программы.
+// Ничего, кроме вывода программы (или листинга ОПЗ для --phase=dump-rpn), в stdout не печатается;
+// ошибки идут в stderr, код возврата 1.
+int run_headless(const CommandLineOptions &options)
+{
+    SourceBuffer source;
+    if (!source.mapFile(options.source_path))
+    {
+        std::cerr << "Не удалось открыть файл: " << options.source_path << std::endl;
+        return 1;
+    }
+
+    FrontEndArena arena;
+    StringInterner lexemes(arena);
+    Lexer lexer(source.text(), lexemes);
+    TokenStream tokens(lexer, lexemes);
+    try
+    {
+        if (options.phase == HeadlessPhase::LEX)
+        {
+            while (tokens.next().code != EOF_TOK)
+            {
+            }
+            return 0;
+        }
+
+        const uint32_t cache_flags = rpn_pass_flags(options);
+        const std::string cache_path = options.cache_dir.empty() ? std::string() : rpn_cache_path(options.cache_dir, source.text(), cache_flags);
+        std::vector<RPNEntry> rpn_output;
+        SymbolTable symbolTable;
+        RPNCacheStatus cache_status = RPNCacheStatus::MISSING;
+        if (!cache_path.empty())
+        {
+            std::string why;
+            cache_status = load_rpn_cache(cache_path, source.text(), cache_flags, rpn_output, symbolTable, why);
+            if (cache_status == RPNCacheStatus::CORRUPT)
+                std::cerr << "Предупреждение: кэш ОПЗ '" << cache_path << "' повреждён (" << why << "), программа перекомпилирована." << std::endl;
+        }
+        if (cache_status != RPNCacheStatus::HIT)
+        {
+            if (tokens.peek().code == EOF_TOK)
+                return 0; // Пустая программа: выполнять нечего
+
+            RPNGenerator rpnGen(tokens);
+            rpn_output = rpnGen.generate();
+            symbolTable = rpnGen.takeSymbolTable();
+            run_rpn_passes(rpn_output, symbolTable, options);
+            if (!cache_path.empty())
+                save_rpn_cache(cache_path, source.text(), cache_flags, rpn_output, symbolTable);
+        }
+
+        if (options.phase == HeadlessPhase::DUMP_RPN)
+        {
+            print_rpn(std::cout, rpn_output);
+            return 0;
+        }
+        if (!options.emit_c_path.empty())
+        {
+            RPNCEmitter emitter(rpn_output, symbolTable);
+            write_c_source(options.emit_c_path, emitter.emit(options.source_path));
+            return 0;
+        }
+        if (options.bench_c)
+        {
+            run_c_benchmark(rpn_output, symbolTable, options.source_path);
+            return 0;
+        }
+
+        g_batchIO.enable(std::cin, options.phase == HeadlessPhase::RUN && program_reads_input(rpn_output));
+        unsigned long long run_allocations = 0;
+        if (options.backend == ExecutionBackend::REGISTER)
+        {
+            RegisterLowering lowering(rpn_output, symbolTable);
+            RegisterProgram program = lowering.lower();
+            if (options.phase == HeadlessPhase::COMPILE)
+                return 0;
+            RegisterVM vm(program);
+            unsigned long long allocations_before = g_heapAllocations;
+            vm.run();
+            run_allocations = g_heapAllocations - allocations_before;
+        }
+        else if (options.backend == ExecutionBackend::JIT)
+        {
+            RPNJit jit(rpn_output, symbolTable);
+            if (options.phase == HeadlessPhase::COMPILE)
+                return 0;
+            unsigned long long allocations_before = g_heapAllocations;
+            jit.run();
+            run_allocations = g_heapAllocations - allocations_before;
+        }
+        else
+        {
+            if (options.phase == HeadlessPhase::COMPILE)
+                return 0;
+            RPNInterpreter interpreter(rpn_output, symbolTable);
+            unsigned long long allocations_before = g_heapAllocations;
+            run_stack_interpreter(interpreter, rpn_output, options, std::cerr);
+            run_allocations = g_heapAllocations - allocations_before;
+        }
+        g_batchIO.flush();
+
+        if (options.count_allocations)
+        {
+            std::cerr << "Heap allocations during run(): " << run_allocations << std::endl;
+            if (run_allocations != 0)
+            {
+                std::cerr << "Ошибка: run() allocated on the heap." << std::endl;
+                return 1;
+            }
+        }
+    }
+    catch (const std::runtime_error &e)
+    {
+        g_batchIO.flush();
+        std::cerr << "Ошибка: " << e.what() << std::endl;
+        return 1;
     }
+    return 0;
 }
 
 // Main Function
-int main()
+int main(int argc, char *argv[])
 {
-    std::cout << "Введите путь к файлу с кодом или введите код вручную (завершите EOF - Ctrl+D/Ctrl+Z+Enter):\n";
+    CommandLineOptions options;
+    try
+    {
+        options = parse_command_line(argc, argv);
+    }
+    catch (const std::runtime_error &e)
+    {
+        std::cerr << "Ошибка: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (options.bench_trig)
+        return run_trig_benchmark() ? 0 : 1;
+    if (options.bench)
+    {
+        try
+        {
+            run_benchmark_suite(options);
+            return 0;
+        }
+        catch (const std::runtime_error &e)
+        {
+            std::cerr << "Ошибка: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    if (!options.source_path.empty())
+        return run_headless(options);
+    if (options.stress_parse_statements > 0)
+    {
+        try
+        {
+            return run_stress_parse(options.stress_parse_statements) ? 0 : 1;
+        }
+        catch (const std::runtime_error &e)
+        {
+            std::cerr << "Ошибка: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    // В пакетном режиме первая строка stdin - путь к файлу, остальное - ввод программы
+    if (!options.batch)
+        std::cout << "Введите путь к файлу с кодом или введите код вручную (завершите EOF - Ctrl+D/Ctrl+Z+Enter):\n";
     std::string filepath_or_code;
-    std::cout << "Путь к файлу (или 'manual' для ручного ввода): ";
+    if (!options.batch)
+        std::cout << "Путь к файлу (или 'manual' для ручного ввода): ";
     std::getline(std::cin, filepath_or_code);
 
-    std::istream *inputStreamPtr = nullptr;
-    std::ifstream fileStream;
-    std::stringstream stringStream;
+    SourceBuffer source;
 
     if (filepath_or_code == "manual")
     {
-        std::cout << "Введите ваш код. Завершите EOF (Ctrl+D в Linux/macOS, Ctrl+Z затем Enter в Windows).\n";
-        std::cout << "-------------------------------------------------------\n";
+        if (!options.batch)
+        {
+            std::cout << "Введите ваш код. Завершите EOF (Ctrl+D в Linux/macOS, Ctrl+Z затем Enter в Windows).\n";
+            std::cout << "-------------------------------------------------------\n";
+        }
         std::string line;
         std::string full_code;
         while (std::getline(std::cin, line))
         {
             full_code += line + "\n";
         }
-        stringStream.str(full_code);
-        inputStreamPtr = &stringStream;
+        source.assign(std::move(full_code));
     }
     else
     {
-        fileStream.open(filepath_or_code);
-        if (!fileStream.is_open())
+        if (!source.mapFile(filepath_or_code))
         {
             std::cerr << "Не удалось открыть файл: " << filepath_or_code << std::endl;
             return 1;
         }
-        inputStreamPtr = &fileStream;
         std::cout << "Чтение из файла: " << filepath_or_code << std::endl;
     }
 
-    Lexer lexer(*inputStreamPtr);
-    std::vector<Token> tokens;
-    Token t;
+    FrontEndArena arena;
+    StringInterner lexemes(arena);
+    Lexer lexer(source.text(), lexemes);
+    TokenStream tokens(lexer, lexemes, &std::cout);
 
     std::cout << "\n--- Распознанные токены ---" << std::endl;
-    do
+    try
     {
-        t = lexer.getNextToken();
-        if (t.code != NONE_TOK)
-        { // Avoid printing NONE_TOK if lexer has internal empty states
-            std::cout << "  " << t.codeToString() << " : \"" << t.lexeme << "\" (Line: " << t.line << ")" << std::endl;
-            tokens.push_back(t);
-        }
-        if (t.code == ERROR_TOK)
+        if (tokens.peek().code == EOF_TOK)
         {
-            std::cerr << "Лексический анализ остановлен из-за ошибки." << std::endl;
-            return 1;
+            std::cout << "--- Конец списка токенов ---\n"
+                      << std::endl;
+            std::cout << "Нет токенов для парсинга (кроме EOF)." << std::endl;
+            return 0;
         }
-        if (tokens.size() > 10000)
-        { // Increased limit slightly
-            std::cerr << "Слишком много токенов (>10000), прерывание." << std::endl;
-            return 1;
-        }
-    } while (t.code != EOF_TOK);
-    std::cout << "--- Конец списка токенов ---\n"
-              << std::endl;
-
-    if (tokens.empty() || (tokens.size() == 1 && tokens.back().code == EOF_TOK))
-    {
-        std::cout << "Нет токенов для парсинга (кроме EOF)." << std::endl;
-        return 0;
-    }
 
-    try
-    {
+        // Tokens are listed as the parser pulls them
         RPNGenerator rpnGen(tokens);
         std::vector<RPNEntry> rpn_output = rpnGen.generate();
-
-        std::cout << "--- ОПЗ (RPN) ---" << std::endl;
-        if (rpn_output.empty())
-            std::cout << "  (пусто)" << std::endl;
-        int rpn_idx = 0;
-        for (const auto &entry : rpn_output)
-        {
-            std::cout << "  " << rpn_idx++ << ": Line " << entry.line_num << ": " << entry.typeToString()
-                      << " Value: \"" << entry.value << "\"" << std::endl;
-        }
-        std::cout << "--- Конец ОПЗ ---\n"
+        std::cout << "--- Конец списка токенов ---\n"
                   << std::endl;
 
+        run_rpn_passes(rpn_output, rpnGen.getSymbolTable(), options, &std::cout);
+
+        print_rpn(std::cout, rpn_output);
+
         std::cout << "--- Таблица символов ---" << std::endl;
         if (rpnGen.getSymbolTable().empty())
             std::cout << "  (пусто)" << std::endl;
-        for (const auto &pair : rpnGen.getSymbolTable())
+        for (const SymbolInfo &info : rpnGen.getSymbolTable())
         {
-            std::cout << "  '" << pair.first << "':"
-                      << " Class=" << symbolClassToString(pair.second.s_class)
-                      << ", TypeToken=" << symbolTypeToString(pair.second.type_token)
-                      << ", Size=" << pair.second.size
-                      << ", DeclLine=" << pair.second.declaration_line
-                      << ", Declared=" << (pair.second.is_declared ? "true" : "false") << std::endl;
+            std::cout << "  '" << info.name << "':"
+                      << " Class=" << symbolClassToString(info.s_class)
+                      << ", TypeToken=" << symbolTypeToString(info.type_token)
+                      << ", Size=" << info.size
+                      << ", DeclLine=" << info.declaration_line
+                      << ", Slot=" << info.slot
+                      << ", Declared=" << (info.is_declared ? "true" : "false") << std::endl;
         }
         std::cout << "--- Конец таблицы символов ---\n"
                   << std::endl;
 
-        std::cout << "--- Запуск интерпретатора ОПЗ ---" << std::endl;
-        RPNInterpreter interpreter(rpn_output, rpnGen.getSymbolTable());
-        interpreter.run();
-        std::cout << "--- Интерпретация завершена ---" << std::endl;
+        if (!options.emit_c_path.empty())
+        {
+            RPNCEmitter emitter(rpn_output, rpnGen.getSymbolTable());
+            write_c_source(options.emit_c_path, emitter.emit(filepath_or_code));
+            std::cout << "--- C-код записан в " << options.emit_c_path << " ---" << std::endl;
+            return 0;
+        }
+        if (options.bench_c)
+        {
+            run_c_benchmark(rpn_output, rpnGen.getSymbolTable(), filepath_or_code);
+            return 0;
+        }
+
+        if (options.batch)
+            g_batchIO.enable(std::cin, program_reads_input(rpn_output));
+        unsigned long long run_allocations = 0;
+        if (options.backend == ExecutionBackend::REGISTER)
+        {
+            RegisterLowering lowering(rpn_output, rpnGen.getSymbolTable());
+            RegisterProgram program = lowering.lower();
+
+            std::cout << "--- Регистровый код ---" << std::endl;
+            for (size_t i = 0; i < program.code.size(); ++i)
+            {
+                std::cout << "  " << i << ": Line " << program.code[i].line_num << ": " << program.instrToString(program.code[i]) << std::endl;
+            }
+            std::cout << "  RPN entries: " << program.rpn_entries << ", instructions: " << program.code.size()
+                      << ", virtual registers: " << program.temporaries << ", registers used: " << program.register_count
+                      << "/" << RegisterLowering::kRegisterFileSize << ", spilled: " << program.spill_count << std::endl;
+            std::cout << "--- Конец регистрового кода ---\n"
+                      << std::endl;
+
+            std::cout << "--- Запуск регистровой машины ---" << std::endl;
+            RegisterVM vm(program);
+            unsigned long long allocations_before = g_heapAllocations;
+            vm.run();
+            run_allocations = g_heapAllocations - allocations_before;
+            g_batchIO.flush();
+            std::cout << "--- Интерпретация завершена ---" << std::endl;
+        }
+        else if (options.backend == ExecutionBackend::JIT)
+        {
+            RPNJit jit(rpn_output, rpnGen.getSymbolTable());
+            std::cout << "--- JIT: " << rpn_output.size() << " RPN entries -> " << jit.nativeCodeSize()
+                      << " bytes of x86-64 code ---" << std::endl;
+            std::cout << "--- Запуск машинного кода ---" << std::endl;
+            unsigned long long allocations_before = g_heapAllocations;
+            jit.run();
+            run_allocations = g_heapAllocations - allocations_before;
+            g_batchIO.flush();
+            std::cout << "--- Интерпретация завершена ---" << std::endl;
+        }
+        else
+        {
+            std::cout << "--- Запуск интерпретатора ОПЗ ---" << std::endl;
+            RPNInterpreter interpreter(rpn_output, rpnGen.getSymbolTable());
+            unsigned long long allocations_before = g_heapAllocations;
+            run_stack_interpreter(interpreter, rpn_output, options, std::cout);
+            run_allocations = g_heapAllocations - allocations_before;
+            g_batchIO.flush();
+            std::cout << "--- Интерпретация завершена ---" << std::endl;
+        }
+
+        if (options.count_allocations)
+        {
+            // The hot path must not touch the heap: any allocation here is a regression
+            std::cout << "Heap allocations during run(): " << run_allocations << std::endl;
+            if (run_allocations != 0)
+            {
+                std::cerr << "Ошибка: run() allocated on the heap." << std::endl;
+                return 1;
+            }
+        }
     }
     catch (const std::runtime_error &e)
     {
+        g_batchIO.flush(); // Output produced before the error comes first
         std::cerr << "Ошибка: " << e.what() << std::endl;
         return 1;
     }
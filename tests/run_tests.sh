@@ -0,0 +1,101 @@
+#!/usr/bin/env bash
+# Регрессионные тесты. Каждая программа tests/NAME.txt запускается во всех конфигурациях проходов
+# оптимизации и движков; её вывод (stdout и stderr) и код возврата сравниваются с tests/NAME.expected.
+# Ввод программы берётся из tests/NAME.in, если он есть. Номер записи ОПЗ в сообщениях об ошибках
+# ("RPN PC N") зависит от проходов, поэтому из сравнения исключается.
+# Затем для каждого движка проверяется, что цикл выполнения не выделяет память в куче (--count-allocs),
+# и разбирается сгенерированная программа из миллиона операторов (--stress-parse).
+#
+# Usage: tests/run_tests.sh COMPILER [--update]
+#   --update  rewrite the .expected files from the default configuration
+
+set -u
+
+if [ $# -lt 1 ]; then
+    echo "Usage: $0 COMPILER [--update]" >&2
+    exit 2
+fi
+compiler=$1
+update=${2:-}
+tests_dir=$(cd "$(dirname "$0")" && pwd)
+
+configs=(
+    ""
+    "--no-fold"
+    "--no-dce"
+    "--no-bce"
+    "--no-fuse"
+    "--no-fold --no-dce --no-bce --no-fuse"
+    "--engine=threaded"
+    "--backend=register"
+    "--backend=jit"
+)
+
+# Native code generation exists only on x86-64
+jit_supported=1
+if "$compiler" --backend=jit "$tests_dir/test10.txt" 2>&1 | grep -q "only supported on x86-64"; then
+    echo "note: JIT not supported on this host, skipping --backend=jit"
+    jit_supported=0
+    unset 'configs[${#configs[@]}-1]'
+fi
+
+run_program() # FLAGS PROGRAM
+{
+    local input=/dev/null
+    [ -f "${2%.txt}.in" ] && input=${2%.txt}.in
+    # shellcheck disable=SC2086 # FLAGS is a list of options
+    "$compiler" $1 "$2" < "$input" 2>&1 | sed -E 's/, RPN PC [0-9]+//'
+    echo "exit ${PIPESTATUS[0]}"
+}
+
+passed=0
+failed=0
+for program in "$tests_dir"/*.txt; do
+    name=$(basename "$program" .txt)
+    expected=${program%.txt}.expected
+    if [ "$update" = "--update" ]; then
+        run_program "" "$program" > "$expected"
+    fi
+    if [ ! -f "$expected" ]; then
+        echo "FAIL $name: missing $(basename "$expected")"
+        failed=$((failed + 1))
+        continue
+    fi
+    for flags in "${configs[@]}"; do
+        if actual=$(run_program "$flags" "$program") && [ "$actual" = "$(cat "$expected")" ]; then
+            passed=$((passed + 1))
+        else
+            echo "FAIL $name [${flags:-default}]"
+            diff <(echo "$actual") "$expected" | sed 's/^/    /'
+            failed=$((failed + 1))
+        fi
+    done
+done
+
+# The run loop must not touch the heap. Programs that stop on an error leave through an exception
+# before the count is printed, so only the ones expected to finish are checked.
+alloc_configs=("" "--engine=threaded" "--backend=register")
+[ "$jit_supported" -eq 1 ] && alloc_configs+=("--backend=jit")
+for program in "$tests_dir"/*.txt; do
+    name=$(basename "$program" .txt)
+    [ "$(tail -n 1 "${program%.txt}.expected" 2>/dev/null)" = "exit 0" ] || continue
+    for flags in "${alloc_configs[@]}"; do
+        if run_program "--count-allocs $flags" "$program" | grep -qx "Heap allocations during run(): 0"; then
+            passed=$((passed + 1))
+        else
+            echo "FAIL $name [--count-allocs ${flags:-default}]: run() allocated on the heap"
+            failed=$((failed + 1))
+        fi
+    done
+done
+
+# Statement lists are parsed iteratively, so a generated million-statement program must not exhaust the stack
+if "$compiler" --stress-parse=1000000 > /dev/null 2>&1; then
+    passed=$((passed + 1))
+else
+    echo "FAIL --stress-parse=1000000"
+    failed=$((failed + 1))
+fi
+
+echo "$passed passed, $failed failed"
+[ "$failed" -eq 0 ]